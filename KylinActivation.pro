@@ -1,12 +1,46 @@
-QT += core gui sql widgets
+QT += core gui sql widgets concurrent
 TARGET = KylinActivationManager
 TEMPLATE = app
 
+# 有 libzstd 时 LICENSE/.kyinfo 用 zstd 压缩，否则用 qCompress
+packagesExist(libzstd) {
+    CONFIG += link_pkgconfig
+    PKGCONFIG += libzstd
+    DEFINES += KYLIN_HAVE_ZSTD
+}
+
 SOURCES += \
     main.cpp \
     mainwindow.cpp \
-    activationdialog.cpp
+    activationdialog.cpp \
+    benchmark.cpp \
+    blobstore.cpp \
+    commandline.cpp \
+    csvparser.cpp \
+    dataexporter.cpp \
+    activationstore.cpp \
+    databaseworker.cpp \
+    operationjournal.cpp \
+    querymonitor.cpp \
+    schemamigrations.cpp \
+    serialtreemodel.cpp \
+    statementcache.cpp \
+    trigramindex.cpp
 
 HEADERS += \
     mainwindow.h \
-    activationdialog.h
+    activationdialog.h \
+    benchmark.h \
+    blobstore.h \
+    commandline.h \
+    csvparser.h \
+    dataexporter.h \
+    activationstore.h \
+    databaseworker.h \
+    operationjournal.h \
+    querymonitor.h \
+    serialrecord.h \
+    schemamigrations.h \
+    serialtreemodel.h \
+    statementcache.h \
+    trigramindex.h
@@ -0,0 +1,1437 @@
+#include "activationstore.h"
+#include "querymonitor.h"
+#include "schemamigrations.h"
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QFile>
+#include <QSaveFile>
+#include <QDebug>
+#include <QSet>
+#include <QUuid>
+#include <QStandardPaths>
+#include <algorithm>
+
+// 单条语句的最大绑定参数个数（SQLite 旧版本上限为 999）
+static const int MaxInParameters = 500;
+
+static const char *const SerialColumns =
+        "serial_number, total_activations, remaining_activations, platform, "
+        "verification_code, bind_wechat, bind_person, ";
+
+// 每个序列号的激活信息条数，由 activation_info.serial_number 上的索引计算
+static const char *const ActivationCountColumn =
+        ", (SELECT COUNT(*) FROM activation_info a "
+        "WHERE a.serial_number = serial_numbers.serial_number) AS activation_count";
+
+// 列表查询的完整列（与 readSerial 的顺序一致）
+static QString serialSelect()
+{
+    return QString("SELECT ") + SerialColumns + BlobStore::sizeColumns() + ActivationCountColumn
+            + ", license_hash, kyinfo_hash, version FROM serial_numbers";
+}
+
+static SerialRecord readSerial(const QSqlQuery &query)
+{
+    SerialRecord record;
+    record.serialNumber = query.value(0).toString();
+    record.totalActivations = query.value(1).toInt();
+    record.remainingActivations = query.value(2).toInt();
+    record.platform = query.value(3).toString();
+    record.verificationCode = query.value(4).toString();
+    record.bindWechat = query.value(5).toString();
+    record.bindPerson = query.value(6).toString();
+    record.licenseSize = query.value(7).toLongLong();
+    record.kyinfoSize = query.value(8).toLongLong();
+    record.activationCount = query.value(9).toInt();
+    record.licenseHash = query.value(10).toString();
+    record.kyinfoHash = query.value(11).toString();
+    record.version = query.value(12).toInt();
+    return record;
+}
+
+// 变更日志空缺的等待时间（秒）：空缺之后的记录写入超过这个时间，空缺视为回滚而不再等待
+static const int ChangeGapTimeout = 60;
+
+// 缓存的 IN 列表语句只按这几种长度预编译，不足的用最后一个值补齐（重复值不影响结果），
+// 每个连接上最多缓存这几条，而不是每种长度一条
+static int paddedParameterCount(int count)
+{
+    static const int sizes[] = { 1, 10, 100 };
+    for (int size : sizes) {
+        if (count <= size) {
+            return size;
+        }
+    }
+    return MaxInParameters;
+}
+
+static QString placeholders(int count)
+{
+    QStringList marks;
+    for (int i = 0; i < count; ++i) {
+        marks << "?";
+    }
+    return marks.join(", ");
+}
+
+DatabaseConfig DatabaseConfig::defaultConfig()
+{
+    DatabaseConfig config;
+    config.hostName = "192.168.218.128";  // 改为你的服务器IP
+    config.port = 3306;
+    config.databaseName = "kylin_activation";
+    config.userName = "kylin_admin";
+    config.password = "StrongPassword123!";
+#if 0   //本地mysql数据库
+    config.hostName = "127.0.0.1";  // 改为你的服务器IP
+    config.port = 3306;
+    config.databaseName = "mysql";
+    config.userName = "root";
+    config.password = "qwer1234";
+#endif
+    config.connectOptions = "MYSQL_OPT_RECONNECT=1;MYSQL_OPT_CONNECT_TIMEOUT=3";
+
+    // 设置 KYLIN_ACTIVATION_SQLITE=<文件路径> 时改用本地 SQLite 数据库（测试用）
+    QString sqlitePath = qEnvironmentVariable("KYLIN_ACTIVATION_SQLITE");
+    if (!sqlitePath.isEmpty()) {
+        config.driver = "QSQLITE";
+        config.databaseName = sqlitePath;
+        config.connectOptions.clear();
+    }
+
+    // CSV 导入时每条 INSERT 包含的激活码行数
+    int chunk = qEnvironmentVariableIntValue("KYLIN_ACTIVATION_IMPORT_CHUNK");
+    if (chunk > 0) {
+        config.importChunkSize = chunk;
+    }
+
+    // KYLIN_ACTIVATION_COMPRESS=0 时上传的文件不压缩
+    if (qEnvironmentVariableIsSet("KYLIN_ACTIVATION_COMPRESS")) {
+        config.compressBlobs = qEnvironmentVariableIntValue("KYLIN_ACTIVATION_COMPRESS") != 0;
+    }
+
+    // 本地缓存：服务器本身就是 SQLite 时不需要；KYLIN_ACTIVATION_CACHE=0 时关闭
+    const bool cacheDisabled = qEnvironmentVariableIsSet("KYLIN_ACTIVATION_CACHE")
+            && qEnvironmentVariableIntValue("KYLIN_ACTIVATION_CACHE") == 0;
+    if (config.driver != "QSQLITE" && !cacheDisabled) {
+        config.cachePath = QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation)
+                + "/activation_cache.sqlite";
+    }
+    config.journalPath = QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation)
+            + "/pending_operations.json";
+
+    // 慢查询日志：KYLIN_ACTIVATION_SLOW_MS 为阈值（毫秒），小于 0 时不记录
+    config.slowQueryLog = QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation)
+            + "/slow_queries.log";
+    if (qEnvironmentVariableIsSet("KYLIN_ACTIVATION_SLOW_MS")) {
+        config.slowQueryMs = qEnvironmentVariableIntValue("KYLIN_ACTIVATION_SLOW_MS");
+    }
+    return config;
+}
+
+DatabaseConfig DatabaseConfig::cacheConfig() const
+{
+    DatabaseConfig config;
+    config.driver = "QSQLITE";
+    config.databaseName = cachePath;
+    config.importChunkSize = importChunkSize;
+    config.compressBlobs = compressBlobs;
+    config.localCache = true;
+    return config;
+}
+
+ActivationStore::ActivationStore(const QSqlDatabase &db)
+    : db(db),
+      client(QUuid::createUuid().toString()),
+      importChunkSize(500),
+      compressBlobs(true),
+      localCache(false),
+      statements(db)
+{
+}
+
+QSqlDatabase ActivationStore::openDatabase(const DatabaseConfig &config, const QString &connectionName,
+                                           QString *error)
+{
+    QSqlDatabase db = QSqlDatabase::addDatabase(config.driver, connectionName);
+    db.setHostName(config.hostName);
+    db.setPort(config.port);
+    db.setDatabaseName(config.databaseName);
+    db.setUserName(config.userName);
+    db.setPassword(config.password);
+    db.setConnectOptions(config.connectOptions);
+
+    if (!db.open()) {
+        if (error) {
+            *error = db.lastError().text();
+        }
+    }
+    return db;
+}
+
+bool ActivationStore::initSchema()
+{
+    const QueryMonitor::Operation operation(__func__);
+    error.clear();
+    QSqlQuery query(db);
+
+    if (isSqlite()) {
+        // 创建序列号表
+        if (!QueryMonitor::exec(query, "CREATE TABLE IF NOT EXISTS serial_numbers ("
+                                       "serial_number TEXT PRIMARY KEY, "
+                                       "total_activations INTEGER, "
+                                       "remaining_activations INTEGER, "
+                                       "platform TEXT, "
+                                       "verification_code TEXT, "
+                                       "license_file BLOB, "
+                                       "kyinfo_file BLOB, "
+                                       "bind_wechat TEXT, "
+                                       "bind_person TEXT, "
+                                       "license_hash TEXT, "
+                                       "kyinfo_hash TEXT, "
+                                       "version INTEGER NOT NULL DEFAULT 0)")) {
+            return fail("创建serial_numbers表失败: " + query.lastError().text());
+        }
+        if (!ensureColumn("serial_numbers", "version", "INTEGER NOT NULL DEFAULT 0")) {
+            return false;
+        }
+
+        // 创建激活信息表
+        if (!QueryMonitor::exec(query, "CREATE TABLE IF NOT EXISTS activation_info ("
+                                       "id INTEGER PRIMARY KEY AUTOINCREMENT, "
+                                       "serial_number TEXT, "
+                                       "activation_code TEXT, "
+                                       "project_number TEXT, "
+                                       "chassis_number TEXT, "
+                                       "FOREIGN KEY(serial_number) REFERENCES serial_numbers(serial_number))")) {
+            return fail("创建activation_info表失败: " + query.lastError().text());
+        }
+
+        // 创建变更日志表
+        if (!QueryMonitor::exec(query, "CREATE TABLE IF NOT EXISTS change_log ("
+                                       "id INTEGER PRIMARY KEY AUTOINCREMENT, "
+                                       "serial_number TEXT NOT NULL, "
+                                       "client_id TEXT, "
+                                       "changed_at TIMESTAMP DEFAULT CURRENT_TIMESTAMP)")) {
+            return fail("创建change_log表失败: " + query.lastError().text());
+        }
+        QueryMonitor::exec(query, "DELETE FROM change_log WHERE changed_at < datetime('now', '-7 days')");
+
+        // 本地缓存的同步状态
+        if (!QueryMonitor::exec(query, "CREATE TABLE IF NOT EXISTS cache_meta ("
+                                       "key TEXT PRIMARY KEY, "
+                                       "value TEXT)")) {
+            return fail("创建cache_meta表失败: " + query.lastError().text());
+        }
+
+        if (!initBlobs()) {
+            return false;
+        }
+
+        // 搜索用索引；SQLite 不建全文索引，子串搜索使用 LIKE
+        QueryMonitor::exec(query, "CREATE INDEX IF NOT EXISTS idx_activation_serial ON activation_info(serial_number)");
+        QueryMonitor::exec(query, "CREATE INDEX IF NOT EXISTS idx_activation_code ON activation_info(activation_code)");
+        QueryMonitor::exec(query, "CREATE INDEX IF NOT EXISTS idx_project_number ON activation_info(project_number)");
+        QueryMonitor::exec(query, "CREATE INDEX IF NOT EXISTS idx_chassis_number ON activation_info(chassis_number)");
+
+        // SQLite 默认不检查外键，级联删除/更新需要打开；缓存中的删除由 mirrorChanges 自己处理
+        if (!localCache) {
+            QueryMonitor::exec(query, "PRAGMA foreign_keys = ON");
+        }
+        migrateSchema();
+        return true;
+    }
+
+    // 设置编码
+    if (!QueryMonitor::exec(query, "SET NAMES 'utf8mb4'")) {
+        qDebug() << "设置编码失败:" << query.lastError();
+    }
+
+    // 创建表（如果不存在）
+    if (!QueryMonitor::exec(query, "CREATE TABLE IF NOT EXISTS serial_numbers ("
+                                   "serial_number VARCHAR(50) PRIMARY KEY, "
+                                   "total_activations INT, "
+                                   "remaining_activations INT, "
+                                   "platform VARCHAR(20), "
+                                   "verification_code VARCHAR(100), "
+                                   "license_file LONGBLOB, "
+                                   "kyinfo_file LONGBLOB, "
+                                   "bind_wechat VARCHAR(10), "
+                                   "bind_person VARCHAR(50), "
+                                   "license_hash CHAR(64), "
+                                   "kyinfo_hash CHAR(64), "
+                                   "version INT NOT NULL DEFAULT 0)")) {
+        return fail("创建serial_numbers表失败: " + query.lastError().text());
+    }
+    // 旧表补上行版本列
+    if (!ensureColumn("serial_numbers", "version", "INT NOT NULL DEFAULT 0")) {
+        return false;
+    }
+
+    if (!QueryMonitor::exec(query, "CREATE TABLE IF NOT EXISTS activation_info ("
+                                   "id INT AUTO_INCREMENT PRIMARY KEY, "
+                                   "serial_number VARCHAR(50), "
+                                   "activation_code VARCHAR(100), "
+                                   "project_number VARCHAR(50), "
+                                   "chassis_number VARCHAR(50), "
+                                   "FOREIGN KEY(serial_number) REFERENCES serial_numbers(serial_number))")) {
+        return fail("创建activation_info表失败: " + query.lastError().text());
+    }
+
+    if (!QueryMonitor::exec(query, "CREATE TABLE IF NOT EXISTS change_log ("
+                                   "id BIGINT AUTO_INCREMENT PRIMARY KEY, "
+                                   "serial_number VARCHAR(50) NOT NULL, "
+                                   "client_id VARCHAR(40), "
+                                   "changed_at TIMESTAMP DEFAULT CURRENT_TIMESTAMP)")) {
+        return fail("创建change_log表失败: " + query.lastError().text());
+    }
+    // 工作站启动时会全量加载，过旧的日志不再需要
+    QueryMonitor::exec(query, "DELETE FROM change_log WHERE changed_at < NOW() - INTERVAL 7 DAY");
+
+    if (!initBlobs()) {
+        return false;
+    }
+
+    // 搜索用索引：前缀匹配用普通索引，子串匹配用 ngram 全文索引（MySQL 5.7.6 起支持）
+    ensureIndex("activation_info", "idx_activation_code", "INDEX idx_activation_code (activation_code)");
+    ensureIndex("activation_info", "idx_project_number", "INDEX idx_project_number (project_number)");
+    ensureIndex("activation_info", "idx_chassis_number", "INDEX idx_chassis_number (chassis_number)");
+    ensureIndex("serial_numbers", "ft_serial_number", "FULLTEXT INDEX ft_serial_number (serial_number) WITH PARSER ngram");
+    ensureIndex("activation_info", "ft_activation_code", "FULLTEXT INDEX ft_activation_code (activation_code) WITH PARSER ngram");
+    ensureIndex("activation_info", "ft_project_number", "FULLTEXT INDEX ft_project_number (project_number) WITH PARSER ngram");
+    ensureIndex("activation_info", "ft_chassis_number", "FULLTEXT INDEX ft_chassis_number (chassis_number) WITH PARSER ngram");
+
+    fullTextColumns.clear();
+    if (QueryMonitor::exec(query, "SELECT DISTINCT column_name FROM information_schema.statistics "
+                                  "WHERE table_schema = DATABASE() AND index_type = 'FULLTEXT'")) {
+        while (query.next()) {
+            fullTextColumns.insert(query.value(0).toString().toLower());
+        }
+    }
+    qDebug() << "全文索引列:" << fullTextColumns.values();
+
+    migrateSchema();
+    return true;
+}
+
+void ActivationStore::migrateSchema()
+{
+    // 迁移失败（如已有重复激活码）不影响现有功能，只是缺少新索引或约束，下次启动再试
+    SchemaMigrations migrations(db, localCache);
+    if (!migrations.run()) {
+        qDebug() << "数据库结构迁移未完成:" << migrations.lastError();
+    }
+    qDebug() << "数据库结构版本:" << migrations.currentVersion() << "/" << migrations.latestVersion();
+
+    if (qEnvironmentVariableIntValue("KYLIN_ACTIVATION_EXPLAIN") != 0) {
+        QStringList fullScans;
+        for (const QString &line : migrations.explainHotQueries(&fullScans)) {
+            qDebug() << "执行计划" << line;
+        }
+        if (!fullScans.isEmpty()) {
+            qDebug() << "以下高频语句为全表扫描:" << fullScans;
+        }
+    }
+}
+
+bool ActivationStore::explainHotQueries(QStringList &report, QStringList &fullScans)
+{
+    const QueryMonitor::Operation operation(__func__);
+    error.clear();
+    SchemaMigrations migrations(db, localCache);
+    report = migrations.explainHotQueries(&fullScans);
+    return true;
+}
+
+bool ActivationStore::initBlobs()
+{
+    // 旧表补上哈希列
+    const QString hashType = isSqlite() ? "TEXT" : "CHAR(64)";
+    if (!ensureColumn("serial_numbers", "license_hash", hashType)
+        || !ensureColumn("serial_numbers", "kyinfo_hash", hashType)) {
+        return false;
+    }
+
+    // 删除序列号或替换文件时按哈希查找是否还有引用
+    if (isSqlite()) {
+        QSqlQuery query(db);
+        QueryMonitor::exec(query, "CREATE INDEX IF NOT EXISTS idx_license_hash ON serial_numbers(license_hash)");
+        QueryMonitor::exec(query, "CREATE INDEX IF NOT EXISTS idx_kyinfo_hash ON serial_numbers(kyinfo_hash)");
+    } else {
+        ensureIndex("serial_numbers", "idx_license_hash", "INDEX idx_license_hash (license_hash)");
+        ensureIndex("serial_numbers", "idx_kyinfo_hash", "INDEX idx_kyinfo_hash (kyinfo_hash)");
+    }
+
+    BlobStore blobStore(db);
+    blobStore.setCompression(compressBlobs);
+    if (!blobStore.initSchema()) {
+        return fail(blobStore.lastError());
+    }
+
+    // 旧版内嵌在 serial_numbers 中的文件迁移到 blobs 表
+    int migrated = blobStore.migrateInline();
+    if (migrated > 0) {
+        qDebug() << "已迁移" << migrated << "个内嵌文件到 blobs 表";
+    }
+    return true;
+}
+
+bool ActivationStore::ensureColumn(const QString &table, const QString &column, const QString &definition)
+{
+    QSqlQuery query(db);
+    if (isSqlite()) {
+        if (!QueryMonitor::exec(query, "PRAGMA table_info(" + table + ")")) {
+            return fail("读取表结构失败: " + query.lastError().text());
+        }
+        while (query.next()) {
+            if (query.value(1).toString().compare(column, Qt::CaseInsensitive) == 0) {
+                return true;
+            }
+        }
+    } else {
+        query.prepare("SELECT COUNT(*) FROM information_schema.columns "
+                      "WHERE table_schema = DATABASE() AND table_name = ? AND column_name = ?");
+        query.addBindValue(table);
+        query.addBindValue(column);
+        if (!QueryMonitor::exec(query) || !query.next()) {
+            return fail("读取表结构失败: " + query.lastError().text());
+        }
+        if (query.value(0).toInt() > 0) {
+            return true;
+        }
+    }
+
+    if (!QueryMonitor::exec(query, "ALTER TABLE " + table + " ADD COLUMN " + column + " " + definition)) {
+        return fail("添加列 " + column + " 失败: " + query.lastError().text());
+    }
+    return true;
+}
+
+bool ActivationStore::ensureIndex(const QString &table, const QString &indexName, const QString &definition)
+{
+    QSqlQuery query(db);
+    query.prepare("SELECT COUNT(*) FROM information_schema.statistics "
+                  "WHERE table_schema = DATABASE() AND table_name = ? AND index_name = ?");
+    query.addBindValue(table);
+    query.addBindValue(indexName);
+    if (QueryMonitor::exec(query) && query.next() && query.value(0).toInt() > 0) {
+        return true;
+    }
+
+    // 建索引失败（如服务器版本不支持 ngram）不影响使用，只是搜索变慢
+    if (!QueryMonitor::exec(query, "ALTER TABLE " + table + " ADD " + definition)) {
+        qDebug() << "创建索引" << indexName << "失败:" << query.lastError().text();
+        return false;
+    }
+    return true;
+}
+
+bool ActivationStore::isSqlite() const
+{
+    return db.driverName() == "QSQLITE";
+}
+
+bool ActivationStore::checkConnection()
+{
+    const QueryMonitor::Operation operation(__func__);
+    error.clear();
+
+    if (db.isOpen()) {
+        QSqlQuery query(db);
+        if (QueryMonitor::exec(query, "SELECT 1")) {
+            return true;
+        }
+        // 预编译语句随连接失效
+        statements.clear();
+        db.close();
+    }
+    if (!db.open()) {
+        return fail("无法连接数据库: " + db.lastError().text());
+    }
+    return initSchema();
+}
+
+QString ActivationStore::clientId() const
+{
+    return client;
+}
+
+bool ActivationStore::currentChangeCursor(qint64 &cursor)
+{
+    const QueryMonitor::Operation operation(__func__);
+    error.clear();
+
+    // 最近写入的日志之前可能还有未提交的 id，游标停在它们之前，由 fetchChanges 处理空缺
+    QSqlQuery query(db);
+    if (!QueryMonitor::exec(query, "SELECT COALESCE((SELECT MIN(id) - 1 FROM change_log WHERE NOT "
+                                   + changeSettledCondition() + "), (SELECT MAX(id) FROM change_log), 0)")
+            || !query.next()) {
+        return fail("读取变更日志失败: " + query.lastError().text());
+    }
+    cursor = query.value(0).toLongLong();
+    return true;
+}
+
+QString ActivationStore::changeSettledCondition() const
+{
+    return isSqlite() ? QString("(changed_at < datetime('now', '-%1 seconds'))").arg(ChangeGapTimeout)
+                      : QString("(changed_at < NOW() - INTERVAL %1 SECOND)").arg(ChangeGapTimeout);
+}
+
+bool ActivationStore::changeLogCovers(qint64 cursor, bool &covered)
+{
+    const QueryMonitor::Operation operation(__func__);
+    error.clear();
+    covered = false;
+
+    // 日志按 id 连续增长，最早一条不晚于 cursor + 1 即说明中间没有被清理掉的记录
+    QSqlQuery query(db);
+    if (!QueryMonitor::exec(query, "SELECT MIN(id), MAX(id) FROM change_log") || !query.next()) {
+        return fail("读取变更日志失败: " + query.lastError().text());
+    }
+    if (query.value(0).isNull()) {
+        // 日志为空：只有在缓存之后没有任何修改时才算完整
+        covered = cursor == 0;
+        return true;
+    }
+    covered = query.value(0).toLongLong() <= cursor + 1 && query.value(1).toLongLong() >= cursor;
+    return true;
+}
+
+bool ActivationStore::fetchChanges(qint64 cursor, const QSet<qint64> &pending, ChangeSet &changes,
+                                   bool includeOwn)
+{
+    const QueryMonitor::Operation operation(__func__);
+    error.clear();
+    changes.cursor = cursor;
+    changes.pendingIds.clear();
+
+    // 1. 读取游标之后的变更，默认跳过本工作站自己产生的记录
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+    query.prepare("SELECT id, serial_number, client_id, " + changeSettledCondition()
+                  + " FROM change_log WHERE id > ? ORDER BY id LIMIT 1000");
+    query.addBindValue(cursor);
+    if (!QueryMonitor::exec(query)) {
+        return fail("读取变更日志失败: " + query.lastError().text());
+    }
+
+    // 2. 游标连续前进；遇到较新的空缺时停下，之后的 id 记为已处理，上次已处理过的跳过
+    QSet<QString> changed;
+    bool contiguous = true;
+    while (query.next()) {
+        const qint64 id = query.value(0).toLongLong();
+        if (contiguous && (id == changes.cursor + 1 || query.value(3).toBool())) {
+            changes.cursor = id;
+        } else {
+            contiguous = false;
+            changes.pendingIds.insert(id);
+        }
+        if (pending.contains(id)) {
+            continue;
+        }
+        if (includeOwn || query.value(2).toString() != client) {
+            changed.insert(query.value(1).toString());
+        }
+    }
+    if (changed.isEmpty()) {
+        return true;
+    }
+
+    // 3. 只拉取这些序列号及其激活信息
+    const QStringList serialNumbers = changed.values();
+    if (!loadSerialsWhere(serialNumbers, changes.serials)
+            || !loadActivationsWhere(serialNumbers, changes.activations)) {
+        return false;
+    }
+
+    // 4. 日志中有记录但已查不到的序列号视为已删除
+    for (const SerialRecord &record : changes.serials) {
+        changed.remove(record.serialNumber);
+    }
+    changes.removedSerials = changed.values();
+    return true;
+}
+
+bool ActivationStore::loadStatistics(StoreStatistics &statistics)
+{
+    const QueryMonitor::Operation operation(__func__);
+    error.clear();
+    statistics = StoreStatistics();
+
+    QSqlQuery query(db);
+    if (!QueryMonitor::exec(query, "SELECT COUNT(*), COALESCE(SUM(total_activations), 0), "
+                                   "COALESCE(SUM(remaining_activations), 0) FROM serial_numbers") || !query.next()) {
+        return fail("统计序列号失败: " + query.lastError().text());
+    }
+    statistics.serials = query.value(0).toLongLong();
+    statistics.totalActivations = query.value(1).toLongLong();
+    statistics.remainingActivations = query.value(2).toLongLong();
+
+    if (!QueryMonitor::exec(query, "SELECT COUNT(*) FROM activation_info") || !query.next()) {
+        return fail("统计激活信息失败: " + query.lastError().text());
+    }
+    statistics.activations = query.value(0).toLongLong();
+
+    if (!QueryMonitor::exec(query, "SELECT COALESCE(MAX(id), 0) FROM change_log") || !query.next()) {
+        return fail("读取变更日志失败: " + query.lastError().text());
+    }
+    statistics.changeCursor = query.value(0).toLongLong();
+    statistics.schemaVersion = SchemaMigrations(db, localCache).currentVersion();
+    return true;
+}
+
+bool ActivationStore::loadSerialPage(const QString &after, int limit, SerialPage &page)
+{
+    const QueryMonitor::Operation operation(__func__);
+    error.clear();
+    page = SerialPage();
+
+    // 只取标量列、文件大小和激活信息条数，LICENSE/.kyinfo 内容在下载时再按需读取，
+    // 激活信息在展开时再加载；按主键顺序定位，每页的代价与表大小无关
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+    query.prepare(serialSelect()
+                  + (after.isEmpty() ? "" : " WHERE serial_number > ?")
+                  + " ORDER BY serial_number LIMIT ?");
+    if (!after.isEmpty()) {
+        query.addBindValue(after);
+    }
+    query.addBindValue(limit + 1);  // 多取一条判断是否还有下一页
+    if (!QueryMonitor::exec(query)) {
+        return fail("加载序列号失败: " + query.lastError().text());
+    }
+    page.serials.reserve(limit);
+    while (query.next()) {
+        if (page.serials.size() == limit) {
+            page.hasMore = true;
+            break;
+        }
+        page.serials.append(readSerial(query));
+    }
+    return true;
+}
+
+bool ActivationStore::loadSerialsWhere(const QStringList &serialNumbers, QVector<SerialRecord> &serials)
+{
+    for (int first = 0; first < serialNumbers.size(); first += MaxInParameters) {
+        const QStringList chunk = serialNumbers.mid(first, MaxInParameters);
+
+        QSqlQuery query(db);
+        query.setForwardOnly(true);
+        query.prepare(serialSelect() + " WHERE serial_number IN (" + placeholders(chunk.size()) + ")");
+        for (const QString &serialNumber : chunk) {
+            query.addBindValue(serialNumber);
+        }
+        if (!QueryMonitor::exec(query)) {
+            return fail("加载序列号失败: " + query.lastError().text());
+        }
+        while (query.next()) {
+            serials.append(readSerial(query));
+        }
+    }
+    return true;
+}
+
+bool ActivationStore::loadSerials(const QStringList &serialNumbers, QVector<SerialRecord> &serials)
+{
+    const QueryMonitor::Operation operation(__func__);
+    error.clear();
+    return loadSerialsWhere(serialNumbers, serials);
+}
+
+bool ActivationStore::loadActivations(const QString &serialNumber, QVector<ActivationRecord> &activations)
+{
+    const QueryMonitor::Operation operation(__func__);
+    error.clear();
+
+    QHash<QString, QVector<ActivationRecord>> loaded;
+    if (!loadActivationsWhere(QStringList() << serialNumber, loaded)) {
+        return false;
+    }
+    activations = loaded.value(serialNumber);
+    return true;
+}
+
+bool ActivationStore::loadActivations(const QStringList &serialNumbers,
+                                      QHash<QString, QVector<ActivationRecord>> &activations)
+{
+    const QueryMonitor::Operation operation(__func__);
+    error.clear();
+    return loadActivationsWhere(serialNumbers, activations);
+}
+
+bool ActivationStore::loadActivationsWhere(const QStringList &serialNumbers,
+                                           QHash<QString, QVector<ActivationRecord>> &activations)
+{
+    for (int first = 0; first < serialNumbers.size(); first += MaxInParameters) {
+        const QStringList chunk = serialNumbers.mid(first, MaxInParameters);
+
+        // 展开单个主行时只有一个参数，这条语句执行得最频繁
+        const int parameters = paddedParameterCount(chunk.size());
+        QSqlQuery &query = statements.prepare("SELECT serial_number, activation_code, project_number, chassis_number "
+                                              "FROM activation_info WHERE serial_number IN ("
+                                              + placeholders(parameters) + ") ORDER BY id");
+        for (int i = 0; i < parameters; ++i) {
+            query.bindValue(i, chunk.at(qMin(i, chunk.size() - 1)));
+        }
+        if (!statements.exec(query)) {
+            return fail("加载激活信息失败: " + query.lastError().text());
+        }
+        while (query.next()) {
+            ActivationRecord record;
+            record.activationCode = query.value(1).toString();
+            record.projectNumber = query.value(2).toString();
+            record.chassisNumber = query.value(3).toString();
+            activations[query.value(0).toString()].append(record);
+        }
+        query.finish();
+    }
+    return true;
+}
+
+bool ActivationStore::exportBlob(const QString &serialNumber, BlobStore::Kind kind, const QString &filePath,
+                                 qint64 &written)
+{
+    const QueryMonitor::Operation operation(__func__);
+    error.clear();
+    written = 0;
+
+    // 写到临时文件，成功后再替换目标文件
+    QSaveFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return fail("无法保存文件: " + file.errorString());
+    }
+    BlobStore blobStore(db);
+    if (!blobStore.read(serialNumber, kind, &file, &written)) {
+        file.cancelWriting();
+        return fail(blobStore.lastError());
+    }
+    if (written == 0) {
+        file.cancelWriting();
+        return true;
+    }
+    if (!file.commit()) {
+        return fail("无法保存文件: " + file.errorString());
+    }
+    return true;
+}
+
+bool ActivationStore::exportData(const ExportOptions &options, QIODevice *device,
+                                 const DataExporter::Progress &progress, ExportSummary &summary)
+{
+    const QueryMonitor::Operation operation(__func__);
+    error.clear();
+    DataExporter exporter(db);
+    if (!exporter.write(options, device, progress, summary)) {
+        return fail(exporter.lastError());
+    }
+    return true;
+}
+
+// LIKE 模式中的通配符以 ! 转义
+static QString escapeLike(const QString &text)
+{
+    QString escaped = text;
+    escaped.replace("!", "!!").replace("%", "!%").replace("_", "!_");
+    return escaped;
+}
+
+bool ActivationStore::searchSerials(const QString &columnName, const QString &text, SearchMatch match,
+                                    int offset, int limit, SearchPage &page)
+{
+    const QueryMonitor::Operation operation(__func__);
+    error.clear();
+    page = SearchPage();
+
+    static const QStringList searchColumns = {
+        "serial_number", "activation_code", "project_number", "chassis_number"
+    };
+    if (!searchColumns.contains(columnName)) {
+        return fail("不支持的搜索字段: " + columnName);
+    }
+    const QString table = columnName == "serial_number" ? "serial_numbers" : "activation_info";
+    const QString like = columnName + " LIKE ? ESCAPE '!'";
+
+    QString condition;
+    QVariantList values;
+    if (match == PrefixMatch) {
+        condition = like;
+        values << escapeLike(text) + "%";
+    } else if (fullTextColumns.contains(columnName) && text.size() >= 2) {
+        // 全文索引按 ngram 短语筛出候选，LIKE 再确认是真正的子串
+        QString phrase = text;
+        phrase.remove('"');
+        condition = "MATCH(" + columnName + ") AGAINST(? IN BOOLEAN MODE) AND " + like;
+        values << "\"" + phrase + "\"" << "%" + escapeLike(text) + "%";
+    } else {
+        condition = like;
+        values << "%" + escapeLike(text) + "%";
+    }
+
+    // 多取一条判断是否还有下一页
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+    query.prepare("SELECT DISTINCT serial_number FROM " + table + " WHERE " + condition
+                  + " ORDER BY serial_number LIMIT ? OFFSET ?");
+    for (const QVariant &value : values) {
+        query.addBindValue(value);
+    }
+    query.addBindValue(limit + 1);
+    query.addBindValue(offset);
+    if (!QueryMonitor::exec(query)) {
+        return fail("搜索失败: " + query.lastError().text());
+    }
+
+    QStringList serialNumbers;
+    while (query.next()) {
+        serialNumbers.append(query.value(0).toString());
+    }
+    if (serialNumbers.size() > limit) {
+        page.hasMore = true;
+        serialNumbers.removeLast();
+    }
+    if (serialNumbers.isEmpty()) {
+        return true;
+    }
+
+    if (!loadSerialsWhere(serialNumbers, page.serials)
+        || !loadActivationsWhere(serialNumbers, page.activations)) {
+        return false;
+    }
+    std::sort(page.serials.begin(), page.serials.end(), [](const SerialRecord &a, const SerialRecord &b) {
+        return a.serialNumber < b.serialNumber;
+    });
+    return true;
+}
+
+bool ActivationStore::storeUpload(const QString &filePath, QVariant &hash, qint64 &size)
+{
+    hash = QVariant(QVariant::String);
+    size = 0;
+    if (filePath.isEmpty()) {
+        return true;
+    }
+
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return fail("无法读取文件 " + filePath + ": " + file.errorString());
+    }
+    if (file.size() == 0) {
+        return true;
+    }
+
+    BlobStore blobStore(db);
+    blobStore.setCompression(compressBlobs);
+    QString contentHash;
+    if (!blobStore.store(&file, contentHash, size)) {
+        return fail(blobStore.lastError());
+    }
+    hash = contentHash;
+    return true;
+}
+
+bool ActivationStore::addSerial(SerialRecord &record, const QString &licensePath, const QString &kyinfoPath)
+{
+    const QueryMonitor::Operation operation(__func__);
+    error.clear();
+
+    db.transaction();
+
+    // 文件内容按块写入 blobs 表，相同内容只保存一份
+    QVariant licenseHash;
+    QVariant kyinfoHash;
+    if (!storeUpload(licensePath, licenseHash, record.licenseSize)
+        || !storeUpload(kyinfoPath, kyinfoHash, record.kyinfoSize)) {
+        return rollback(error);
+    }
+
+    QSqlQuery query(db);
+    query.prepare("INSERT INTO serial_numbers (serial_number, total_activations, remaining_activations, "
+                  "platform, verification_code, license_hash, kyinfo_hash, bind_wechat, bind_person) "
+                  "VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?)");
+    query.addBindValue(record.serialNumber);
+    query.addBindValue(record.totalActivations);
+    query.addBindValue(record.remainingActivations);
+    query.addBindValue(record.platform);
+    query.addBindValue(record.verificationCode);
+    query.addBindValue(licenseHash);
+    query.addBindValue(kyinfoHash);
+    query.addBindValue(record.bindWechat);
+    query.addBindValue(record.bindPerson);
+
+    if (!QueryMonitor::exec(query)) {
+        return rollback("添加序列号失败: " + query.lastError().text());
+    }
+
+    return commitChange(record.serialNumber);
+}
+
+bool ActivationStore::updateSerialColumn(const QString &serialNumber, const QString &columnName,
+                                         const QVariant &value, int expectedVersion, SerialRecord &updated)
+{
+    const QueryMonitor::Operation operation(__func__);
+    error.clear();
+
+    db.transaction();
+
+    // 列名来自固定的几列，每列一条预编译语句；
+    // 版本号不一致说明界面上的数据已过期，拒绝覆盖其他工作站的修改
+    QSqlQuery &query = statements.prepare(QString("UPDATE serial_numbers SET %1 = ?, version = version + 1 "
+                                                  "WHERE serial_number = ? AND version = ?")
+                                          .arg(columnName));
+    query.bindValue(0, value);
+    query.bindValue(1, serialNumber);
+    query.bindValue(2, expectedVersion);
+    if (!statements.exec(query)) {
+        return rollback("修改失败: " + query.lastError().text());
+    }
+    if (query.numRowsAffected() == 0) {
+        return rollback("修改失败: 序列号 " + serialNumber + " 已被其他工作站修改或删除，请刷新后重试");
+    }
+
+    // 修改序列号本身时，原序列号在其他工作站上表现为删除，新序列号表现为新增
+    if (columnName == "serial_number" && !logChange(value.toString())) {
+        return rollback(error);
+    }
+    if (!commitChange(serialNumber)) {
+        return false;
+    }
+    reloadSerial(columnName == "serial_number" ? value.toString() : serialNumber, updated);
+    return true;
+}
+
+bool ActivationStore::deleteSerial(const QString &serialNumber)
+{
+    const QueryMonitor::Operation operation(__func__);
+    error.clear();
+
+    // 从数据库删除主行和所有关联的子行
+    db.transaction();
+
+    QSqlQuery query(db);
+    query.prepare("SELECT license_hash, kyinfo_hash FROM serial_numbers WHERE serial_number = ?");
+    query.addBindValue(serialNumber);
+    QStringList hashes;
+    if (QueryMonitor::exec(query) && query.next()) {
+        hashes << query.value(0).toString() << query.value(1).toString();
+    }
+
+    query.prepare("DELETE FROM activation_info WHERE serial_number = ?");
+    query.addBindValue(serialNumber);
+    if (!QueryMonitor::exec(query)) {
+        return rollback("删除关联激活信息失败: " + query.lastError().text());
+    }
+
+    query.prepare("DELETE FROM serial_numbers WHERE serial_number = ?");
+    query.addBindValue(serialNumber);
+    if (!QueryMonitor::exec(query)) {
+        return rollback("删除序列号失败: " + query.lastError().text());
+    }
+
+    // 不再被任何序列号引用的文件内容一并删除
+    BlobStore blobStore(db);
+    for (const QString &hash : hashes) {
+        if (!blobStore.release(hash)) {
+            return rollback("删除文件失败: " + blobStore.lastError());
+        }
+    }
+
+    return commitChange(serialNumber);
+}
+
+bool ActivationStore::addActivation(const QString &serialNumber, const ActivationRecord &record,
+                                    SerialRecord &updated)
+{
+    const QueryMonitor::Operation operation(__func__);
+    error.clear();
+
+    db.transaction();
+
+    // 1. 在服务器上原子地扣减剩余激活次数，多个工作站同时添加时不会互相覆盖
+    if (!adjustRemaining(serialNumber, -1)) {
+        return rollback(error);
+    }
+
+    // 2. 数据库插入
+    QSqlQuery &query = statements.prepare("INSERT INTO activation_info "
+                                          "(serial_number, activation_code, project_number, chassis_number) "
+                                          "VALUES (?, ?, ?, ?)");
+    query.bindValue(0, serialNumber);
+    query.bindValue(1, record.activationCode);
+    query.bindValue(2, record.projectNumber);
+    query.bindValue(3, record.chassisNumber);
+    if (!statements.exec(query)) {
+        return rollback("添加激活信息失败: " + query.lastError().text());
+    }
+
+    if (!commitChange(serialNumber)) {
+        return false;
+    }
+    reloadSerial(serialNumber, updated);
+    return true;
+}
+
+bool ActivationStore::updateActivationColumn(const QString &serialNumber, const QString &activationCode,
+                                             const QString &columnName, const QVariant &value)
+{
+    const QueryMonitor::Operation operation(__func__);
+    error.clear();
+
+    db.transaction();
+
+    QSqlQuery &query = statements.prepare(QString("UPDATE activation_info SET %1 = ? "
+                                                  "WHERE serial_number = ? AND activation_code = ?")
+                                          .arg(columnName));
+    query.bindValue(0, value);
+    query.bindValue(1, serialNumber);
+    query.bindValue(2, activationCode);
+    if (!statements.exec(query)) {
+        return rollback("更新数据库失败: " + query.lastError().text());
+    }
+
+    return commitChange(serialNumber);
+}
+
+bool ActivationStore::deleteActivation(const QString &serialNumber, const QString &activationCode,
+                                       SerialRecord &updated)
+{
+    const QueryMonitor::Operation operation(__func__);
+    error.clear();
+
+    db.transaction();
+
+    // 1. 从数据库删除激活信息
+    QSqlQuery &deleteQuery = statements.prepare("DELETE FROM activation_info "
+                                                "WHERE serial_number = ? AND activation_code = ?");
+    deleteQuery.bindValue(0, serialNumber);
+    deleteQuery.bindValue(1, activationCode);
+    if (!statements.exec(deleteQuery)) {
+        return rollback("删除激活信息失败: " + deleteQuery.lastError().text());
+    }
+    // 已被其他工作站删除时不能再归还次数
+    if (deleteQuery.numRowsAffected() == 0) {
+        return rollback("删除激活信息失败: 激活码 " + activationCode + " 已被其他工作站删除");
+    }
+
+    // 2. 原子地归还剩余激活次数
+    if (!adjustRemaining(serialNumber, 1)) {
+        return rollback(error);
+    }
+
+    if (!commitChange(serialNumber)) {
+        return false;
+    }
+    reloadSerial(serialNumber, updated);
+    return true;
+}
+
+bool ActivationStore::importCsv(const CSVData &data)
+{
+    const QueryMonitor::Operation operation(__func__);
+    error.clear();
+
+    db.transaction();
+
+    // 1. 插入主行数据到数据库
+    QSqlQuery mainQuery(db);
+    mainQuery.prepare(
+        "INSERT INTO serial_numbers "
+        "(serial_number, total_activations, remaining_activations, "
+        "platform, bind_wechat, bind_person) "
+        "VALUES (?, ?, ?, '?', '是', 'Excel导入')");
+    mainQuery.addBindValue(data.serialNumber);
+    mainQuery.addBindValue(data.totalActivations);
+    mainQuery.addBindValue(data.remainingActivations);
+    if (!QueryMonitor::exec(mainQuery)) {
+        return rollback(QString("插入序列号失败: %1").arg(mainQuery.lastError().text()));
+    }
+
+    // 2. 激活码按块用多行 VALUES 插入，每块一次往返；任一块失败则整体回滚
+    // QMYSQL 的 execBatch 只是逐行 exec 的模拟，因此这里自行拼接多行语句
+    const int chunkSize = isSqlite() ? qMin(importChunkSize, MaxInParameters / 2) : importChunkSize;
+    const QVector<QPair<QString, QString>> &codes = data.activationCodes;
+
+    QSqlQuery codeQuery(db);
+    int preparedRows = 0;
+    for (int first = 0; first < codes.size(); first += chunkSize) {
+        const int rows = qMin(chunkSize, codes.size() - first);
+
+        // 整块复用同一条预处理语句，只有最后不足一块时重新准备
+        if (rows != preparedRows) {
+            QStringList values;
+            for (int i = 0; i < rows; ++i) {
+                values << "(?, ?, '', '')";  // 项目号、机箱序列号初始化为空字符串
+            }
+            codeQuery.prepare("INSERT INTO activation_info "
+                              "(serial_number, activation_code, project_number, chassis_number) "
+                              "VALUES " + values.join(", "));
+            preparedRows = rows;
+        }
+
+        for (int i = first; i < first + rows; ++i) {
+            codeQuery.addBindValue(data.serialNumber);
+            codeQuery.addBindValue(codes.at(i).second); // 使用激活码
+        }
+        if (!QueryMonitor::exec(codeQuery)) {
+            return rollback(QString("插入第 %1-%2 个激活码失败（%3 起）: %4")
+                            .arg(first + 1).arg(first + rows)
+                            .arg(codes.at(first).second)
+                            .arg(codeQuery.lastError().text()));
+        }
+    }
+
+    if (!commitChange(data.serialNumber)) {
+        return false;
+    }
+    return true;
+}
+
+void ActivationStore::setBlobCompression(bool enabled)
+{
+    compressBlobs = enabled;
+}
+
+void ActivationStore::setLocalCache(bool enabled)
+{
+    localCache = enabled;
+}
+
+bool ActivationStore::recompressBlobs(qint64 &bytesBefore, qint64 &bytesAfter, int &chunks)
+{
+    const QueryMonitor::Operation operation(__func__);
+    error.clear();
+
+    // 每批 32 块（最多约 8MB）
+    BlobStore blobStore(db);
+    if (!blobStore.recompress(32, bytesBefore, bytesAfter, chunks)) {
+        return fail(blobStore.lastError());
+    }
+    return true;
+}
+
+bool ActivationStore::mirrorChanges(const ChangeSet &changes)
+{
+    const QueryMonitor::Operation operation(__func__);
+    error.clear();
+
+    db.transaction();
+    QSet<QString> releasedHashes;
+    if (!removeCachedSerials(changes.removedSerials, releasedHashes)) {
+        return rollback(error);
+    }
+
+    QSqlQuery query(db);
+    QSqlQuery blobQuery(db);
+    blobQuery.prepare("INSERT OR IGNORE INTO blobs (hash, size, chunk_count) VALUES (?, ?, ?)");
+    for (const SerialRecord &record : changes.serials) {
+        // 记下旧的文件哈希，替换后不再被引用的缓存内容一并删除
+        query.prepare("SELECT license_hash, kyinfo_hash FROM serial_numbers WHERE serial_number = ?");
+        query.addBindValue(record.serialNumber);
+        if (QueryMonitor::exec(query) && query.next()) {
+            releasedHashes << query.value(0).toString() << query.value(1).toString();
+        }
+
+        query.prepare("INSERT OR REPLACE INTO serial_numbers (serial_number, total_activations, "
+                      "remaining_activations, platform, verification_code, bind_wechat, bind_person, "
+                      "license_hash, kyinfo_hash, version) VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?)");
+        query.addBindValue(record.serialNumber);
+        query.addBindValue(record.totalActivations);
+        query.addBindValue(record.remainingActivations);
+        query.addBindValue(record.platform);
+        query.addBindValue(record.verificationCode);
+        query.addBindValue(record.bindWechat);
+        query.addBindValue(record.bindPerson);
+        query.addBindValue(record.licenseHash.isEmpty() ? QVariant(QVariant::String) : QVariant(record.licenseHash));
+        query.addBindValue(record.kyinfoHash.isEmpty() ? QVariant(QVariant::String) : QVariant(record.kyinfoHash));
+        query.addBindValue(record.version);
+        if (!QueryMonitor::exec(query)) {
+            return rollback("缓存序列号失败: " + query.lastError().text());
+        }
+
+        // 只登记文件大小，内容在下载时再写入 blob_chunks
+        const QPair<QString, qint64> files[] = {
+            { record.licenseHash, record.licenseSize },
+            { record.kyinfoHash, record.kyinfoSize }
+        };
+        for (const auto &file : files) {
+            if (file.first.isEmpty()) {
+                continue;
+            }
+            blobQuery.bindValue(0, file.first);
+            blobQuery.bindValue(1, file.second);
+            blobQuery.bindValue(2, int((file.second + BlobStore::ChunkSize - 1) / BlobStore::ChunkSize));
+            if (!QueryMonitor::exec(blobQuery)) {
+                return rollback("缓存文件信息失败: " + blobQuery.lastError().text());
+            }
+        }
+
+        // 激活信息整体替换为服务器上的内容
+        query.prepare("DELETE FROM activation_info WHERE serial_number = ?");
+        query.addBindValue(record.serialNumber);
+        if (!QueryMonitor::exec(query)) {
+            return rollback("缓存激活信息失败: " + query.lastError().text());
+        }
+        query.prepare("INSERT INTO activation_info (serial_number, activation_code, project_number, chassis_number) "
+                      "VALUES (?, ?, ?, ?)");
+        for (const ActivationRecord &activation : changes.activations.value(record.serialNumber)) {
+            query.bindValue(0, record.serialNumber);
+            query.bindValue(1, activation.activationCode);
+            query.bindValue(2, activation.projectNumber);
+            query.bindValue(3, activation.chassisNumber);
+            if (!QueryMonitor::exec(query)) {
+                return rollback("缓存激活信息失败: " + query.lastError().text());
+            }
+        }
+    }
+
+    BlobStore blobStore(db);
+    for (const QString &hash : releasedHashes) {
+        if (!blobStore.release(hash)) {
+            return rollback("清理缓存文件失败: " + blobStore.lastError());
+        }
+    }
+
+    if (!db.commit()) {
+        return rollback("提交事务失败: " + db.lastError().text());
+    }
+    return true;
+}
+
+bool ActivationStore::retainSerials(const QSet<QString> &serialNumbers)
+{
+    const QueryMonitor::Operation operation(__func__);
+    error.clear();
+
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+    if (!QueryMonitor::exec(query, "SELECT serial_number FROM serial_numbers")) {
+        return fail("读取缓存失败: " + query.lastError().text());
+    }
+    QStringList stale;
+    while (query.next()) {
+        const QString serialNumber = query.value(0).toString();
+        if (!serialNumbers.contains(serialNumber)) {
+            stale.append(serialNumber);
+        }
+    }
+    if (stale.isEmpty()) {
+        return true;
+    }
+
+    db.transaction();
+    QSet<QString> releasedHashes;
+    if (!removeCachedSerials(stale, releasedHashes)) {
+        return rollback(error);
+    }
+    BlobStore blobStore(db);
+    for (const QString &hash : releasedHashes) {
+        if (!blobStore.release(hash)) {
+            return rollback("清理缓存文件失败: " + blobStore.lastError());
+        }
+    }
+    if (!db.commit()) {
+        return rollback("提交事务失败: " + db.lastError().text());
+    }
+    qDebug() << "已从缓存中删除" << stale.size() << "个服务器上不存在的序列号";
+    return true;
+}
+
+bool ActivationStore::removeCachedSerials(const QStringList &serialNumbers, QSet<QString> &releasedHashes)
+{
+    // 由调用方开启事务
+    QSqlQuery query(db);
+    for (const QString &serialNumber : serialNumbers) {
+        query.prepare("SELECT license_hash, kyinfo_hash FROM serial_numbers WHERE serial_number = ?");
+        query.addBindValue(serialNumber);
+        if (QueryMonitor::exec(query) && query.next()) {
+            releasedHashes << query.value(0).toString() << query.value(1).toString();
+        }
+        query.prepare("DELETE FROM activation_info WHERE serial_number = ?");
+        query.addBindValue(serialNumber);
+        if (!QueryMonitor::exec(query)) {
+            return fail("删除缓存激活信息失败: " + query.lastError().text());
+        }
+        query.prepare("DELETE FROM serial_numbers WHERE serial_number = ?");
+        query.addBindValue(serialNumber);
+        if (!QueryMonitor::exec(query)) {
+            return fail("删除缓存序列号失败: " + query.lastError().text());
+        }
+    }
+    return true;
+}
+
+bool ActivationStore::readMeta(const QString &key, QString &value)
+{
+    const QueryMonitor::Operation operation(__func__);
+    error.clear();
+    value.clear();
+
+    QSqlQuery query(db);
+    query.prepare("SELECT value FROM cache_meta WHERE key = ?");
+    query.addBindValue(key);
+    if (!QueryMonitor::exec(query)) {
+        return fail("读取缓存状态失败: " + query.lastError().text());
+    }
+    if (query.next()) {
+        value = query.value(0).toString();
+    }
+    return true;
+}
+
+bool ActivationStore::writeMeta(const QString &key, const QString &value)
+{
+    const QueryMonitor::Operation operation(__func__);
+    error.clear();
+
+    QSqlQuery query(db);
+    query.prepare("INSERT OR REPLACE INTO cache_meta (key, value) VALUES (?, ?)");
+    query.addBindValue(key);
+    query.addBindValue(value);
+    if (!QueryMonitor::exec(query)) {
+        return fail("保存缓存状态失败: " + query.lastError().text());
+    }
+    return true;
+}
+
+bool ActivationStore::isBlobCached(const QString &serialNumber, BlobStore::Kind kind, bool &cached)
+{
+    const QueryMonitor::Operation operation(__func__);
+    error.clear();
+    cached = false;
+
+    QSqlQuery query(db);
+    query.prepare(QString("SELECT %1 FROM serial_numbers WHERE serial_number = ?").arg(BlobStore::hashColumnName(kind)));
+    query.addBindValue(serialNumber);
+    if (!QueryMonitor::exec(query)) {
+        return fail("读取缓存失败: " + query.lastError().text());
+    }
+    if (!query.next() || query.value(0).toString().isEmpty()) {
+        return true;
+    }
+
+    BlobStore blobStore(db);
+    cached = blobStore.isComplete(query.value(0).toString());
+    return true;
+}
+
+bool ActivationStore::cacheBlob(const QString &filePath)
+{
+    const QueryMonitor::Operation operation(__func__);
+    error.clear();
+
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return fail("无法读取文件: " + file.errorString());
+    }
+
+    // 哈希与缓存中序列号行记录的相同，写入后即可直接从缓存下载
+    BlobStore blobStore(db);
+    blobStore.setCompression(compressBlobs);
+    QString hash;
+    qint64 size = 0;
+    db.transaction();
+    if (!blobStore.store(&file, hash, size)) {
+        return rollback(blobStore.lastError());
+    }
+    // 下载期间服务器上的文件已被替换时，内容不再被引用，不必保留
+    if (!blobStore.release(hash)) {
+        return rollback(blobStore.lastError());
+    }
+    if (!db.commit()) {
+        return rollback("提交事务失败: " + db.lastError().text());
+    }
+    return true;
+}
+
+void ActivationStore::setImportChunkSize(int rows)
+{
+    importChunkSize = qMax(1, rows);
+}
+
+bool ActivationStore::commitChange(const QString &serialNumber)
+{
+    // 变更日志与数据修改在同一事务中提交
+    if (!logChange(serialNumber)) {
+        return rollback(error);
+    }
+    if (!db.commit()) {
+        return rollback("提交事务失败: " + db.lastError().text());
+    }
+    return true;
+}
+
+bool ActivationStore::logChange(const QString &serialNumber)
+{
+    QSqlQuery &query = statements.prepare("INSERT INTO change_log (serial_number, client_id) VALUES (?, ?)");
+    query.bindValue(0, serialNumber);
+    query.bindValue(1, client);
+    if (!statements.exec(query)) {
+        error = "记录变更日志失败: " + query.lastError().text();
+        return false;
+    }
+    return true;
+}
+
+bool ActivationStore::adjustRemaining(const QString &serialNumber, int delta)
+{
+    // 在当前值上加减，扣减时不低于 0；同时增加行版本
+    QSqlQuery &query = statements.prepare(delta < 0
+            ? "UPDATE serial_numbers SET remaining_activations = remaining_activations - 1, "
+              "version = version + 1 WHERE serial_number = ? AND remaining_activations > 0"
+            : "UPDATE serial_numbers SET remaining_activations = remaining_activations + 1, "
+              "version = version + 1 WHERE serial_number = ?");
+    query.bindValue(0, serialNumber);
+    if (!statements.exec(query)) {
+        error = "更新剩余激活次数失败: " + query.lastError().text();
+        return false;
+    }
+    if (query.numRowsAffected() == 0) {
+        error = delta < 0 ? "序列号 " + serialNumber + " 没有剩余激活次数"
+                          : "序列号 " + serialNumber + " 已被其他工作站删除";
+        return false;
+    }
+    return true;
+}
+
+void ActivationStore::reloadSerial(const QString &serialNumber, SerialRecord &record)
+{
+    // 修改已提交，读取失败时 record 为空，调用方在本地更新或等待同步
+    QVector<SerialRecord> serials;
+    loadSerialsWhere(QStringList() << serialNumber, serials);
+    record = serials.isEmpty() ? SerialRecord() : serials.first();
+    error.clear();
+}
+
+QVector<StatementCache::Stats> ActivationStore::statementStats() const
+{
+    return statements.stats();
+}
+
+void ActivationStore::logStatementStats() const
+{
+    statements.logStats();
+}
+
+QString ActivationStore::lastError() const
+{
+    return error;
+}
+
+QSqlDatabase ActivationStore::database() const
+{
+    return db;
+}
+
+bool ActivationStore::fail(const QString &message)
+{
+    error = message;
+    qDebug() << message;
+    return false;
+}
+
+bool ActivationStore::rollback(const QString &message)
+{
+    db.rollback();
+    return fail(message);
+}
@@ -0,0 +1,204 @@
+#ifndef ACTIVATIONSTORE_H
+#define ACTIVATIONSTORE_H
+
+#include <QSqlDatabase>
+#include <QHash>
+#include <QVariant>
+#include <QStringList>
+#include <QSet>
+#include "serialrecord.h"
+#include "blobstore.h"
+#include "statementcache.h"
+#include "dataexporter.h"
+
+// 数据库连接参数
+struct DatabaseConfig {
+    QString driver = "QMYSQL";
+    QString hostName;
+    int port = 3306;
+    QString databaseName;
+    QString userName;
+    QString password;
+    QString connectOptions;
+    int importChunkSize = 500;
+    bool compressBlobs = true;
+    QString cachePath;  // 本地 SQLite 缓存文件，为空表示不使用缓存
+    QString journalPath;  // 离线操作日志
+    bool localCache = false;  // 本连接是否为本地缓存
+    QString slowQueryLog;     // 慢查询日志文件，为空表示不记录
+    int slowQueryMs = 200;
+
+    static DatabaseConfig defaultConfig();
+    DatabaseConfig cacheConfig() const;
+};
+
+// 工作线程返回给界面的查询结果
+template <typename T>
+struct StoreResult {
+    bool ok = false;
+    QString error;
+    T value;
+};
+
+// 从变更日志拉取的增量
+struct ChangeSet {
+    qint64 cursor = 0;                                    // 此 id 及之前的变更日志都已处理
+    QSet<qint64> pendingIds;                              // 游标之后已处理的 id（游标停在未提交的空缺前）
+    QStringList removedSerials;                           // 服务器上已不存在的序列号
+    QVector<SerialRecord> serials;                        // 新增或修改过的序列号
+    QHash<QString, QVector<ActivationRecord>> activations; // 上述序列号的全部激活信息
+};
+
+// 按序列号顺序分页加载的一页主行
+struct SerialPage {
+    QVector<SerialRecord> serials;
+    bool hasMore = false;
+};
+
+// 服务器端搜索的一页结果：命中的序列号及其全部激活信息
+struct SearchPage {
+    QVector<SerialRecord> serials;
+    QHash<QString, QVector<ActivationRecord>> activations;
+    bool hasMore = false;
+};
+
+// 数据量统计（命令行 stats）
+struct StoreStatistics {
+    qint64 serials = 0;
+    qint64 activations = 0;
+    qint64 totalActivations = 0;      // 各序列号总激活次数之和
+    qint64 remainingActivations = 0;  // 各序列号剩余激活次数之和
+    qint64 changeCursor = 0;
+    int schemaVersion = 0;
+};
+
+// 序列号/激活信息的数据库读写
+// 不依赖任何界面组件，只在打开该连接的线程中使用；
+// 语句都经 QueryMonitor 执行，各公开方法的名称记为语句所属的操作
+class ActivationStore
+{
+public:
+    explicit ActivationStore(const QSqlDatabase &db);
+
+    static QSqlDatabase openDatabase(const DatabaseConfig &config, const QString &connectionName,
+                                     QString *error = nullptr);
+
+    // 建表后执行未完成的结构迁移（见 SchemaMigrations）
+    bool initSchema();
+    bool isSqlite() const;
+    // 本地缓存连接不执行约束类迁移
+    void setLocalCache(bool enabled);
+    // 检查连接是否可用，已断开时重新连接（启动时未连上的还要初始化表结构）
+    bool checkConnection();
+
+    // 变更日志：每次修改都在同一事务中记录受影响的序列号，其他工作站据此增量同步
+    QString clientId() const;
+    // 同步起点：最近仍可能有未提交空缺的日志会在第一次同步时重新读取
+    bool currentChangeCursor(qint64 &cursor);
+    // 自增 id 在插入时分配、提交可能晚于更大的 id，游标只前进到第一个空缺之前，
+    // 空缺之后的记录照常返回并记入 changes.pendingIds，下次传入 pending 以免重复处理；
+    // 空缺之后的记录写入超过一分钟仍未补上时视为回滚，游标越过它。
+    // includeOwn 为 true 时也返回本工作站自己的修改（用于同步本地缓存）
+    bool fetchChanges(qint64 cursor, const QSet<qint64> &pending, ChangeSet &changes, bool includeOwn = false);
+    // 游标之后的变更日志是否完整（旧日志会被清理，缓存过旧时需要全量刷新）
+    bool changeLogCovers(qint64 cursor, bool &covered);
+
+    // 读取
+    // 键集分页：取 serial_number 大于 after 的前 limit 个序列号，after 为空时从头开始
+    bool loadSerialPage(const QString &after, int limit, SerialPage &page);
+    bool loadSerials(const QStringList &serialNumbers, QVector<SerialRecord> &serials);
+    bool loadActivations(const QString &serialNumber, QVector<ActivationRecord> &activations);
+    bool loadActivations(const QStringList &serialNumbers, QHash<QString, QVector<ActivationRecord>> &activations);
+    bool loadStatistics(StoreStatistics &statistics);
+    // 把 LICENSE/.kyinfo 按块写到文件，written 返回字节数（0 表示没有文件）
+    bool exportBlob(const QString &serialNumber, BlobStore::Kind kind, const QString &filePath, qint64 &written);
+
+    // 批量导出序列号及激活信息到 device（见 DataExporter）
+    bool exportData(const ExportOptions &options, QIODevice *device, const DataExporter::Progress &progress,
+                    ExportSummary &summary);
+
+    // 服务器端搜索：按列查找序列号，按序列号排序分页返回
+    // 前缀匹配走普通索引；子串匹配在 MySQL 有 ngram 全文索引时先用全文索引筛选，否则退化为 LIKE
+    enum SearchMatch {
+        PrefixMatch,
+        SubstringMatch
+    };
+    bool searchSerials(const QString &columnName, const QString &text, SearchMatch match,
+                       int offset, int limit, SearchPage &page);
+
+    // 序列号
+    // 文件路径为空表示不上传；成功后 record 中的文件大小为实际大小
+    bool addSerial(SerialRecord &record, const QString &licensePath, const QString &kyinfoPath);
+    // 修改类操作成功后 updated 为服务器上修改后的主行，调用方只需刷新这一行
+    // expectedVersion 与服务器上的行版本不一致时拒绝修改
+    bool updateSerialColumn(const QString &serialNumber, const QString &columnName, const QVariant &value,
+                            int expectedVersion, SerialRecord &updated);
+    bool deleteSerial(const QString &serialNumber);
+
+    // 激活信息：剩余激活次数在服务器上原子地加减，没有剩余次数时添加失败
+    bool addActivation(const QString &serialNumber, const ActivationRecord &record, SerialRecord &updated);
+    bool updateActivationColumn(const QString &serialNumber, const QString &activationCode,
+                                const QString &columnName, const QVariant &value);
+    bool deleteActivation(const QString &serialNumber, const QString &activationCode, SerialRecord &updated);
+
+    // CSV 导入：激活码按块批量插入，全部成功或全部回滚
+    bool importCsv(const CSVData &data);
+    void setImportChunkSize(int rows);
+
+    // LICENSE/.kyinfo 块压缩
+    void setBlobCompression(bool enabled);
+    bool recompressBlobs(qint64 &bytesBefore, qint64 &bytesAfter, int &chunks);
+
+    // 本地缓存（只用于缓存连接）
+    // 把服务器上的序列号及其激活信息写入缓存，文件只记录哈希和大小，内容在下载过后才缓存
+    bool mirrorChanges(const ChangeSet &changes);
+    // 删除不在 serialNumbers 中的序列号（全量刷新后清理服务器上已删除的数据）
+    bool retainSerials(const QSet<QString> &serialNumbers);
+    bool readMeta(const QString &key, QString &value);
+    bool writeMeta(const QString &key, const QString &value);
+    // 文件内容是否已在缓存中
+    bool isBlobCached(const QString &serialNumber, BlobStore::Kind kind, bool &cached);
+    // 把从服务器下载的文件存入缓存
+    bool cacheBlob(const QString &filePath);
+
+    // 预编译语句的执行次数和耗时
+    QVector<StatementCache::Stats> statementStats() const;
+    void logStatementStats() const;
+    // 高频语句的执行计划；设置 KYLIN_ACTIVATION_EXPLAIN=1 时启动时也会打印
+    bool explainHotQueries(QStringList &report, QStringList &fullScans);
+
+    QString lastError() const;
+    QSqlDatabase database() const;
+
+private:
+    QSqlDatabase db;
+    QString error;
+    QString client;
+    int importChunkSize;  // 每条 INSERT 语句包含的激活码行数
+    bool compressBlobs;
+    bool localCache;
+    QSet<QString> fullTextColumns;  // 建有全文索引的列
+    StatementCache statements;      // 高频语句只预编译一次
+
+    bool ensureIndex(const QString &table, const QString &indexName, const QString &definition);
+    bool initBlobs();
+    void migrateSchema();
+    // change_log 中写入已超过等待时间的记录（其前面的空缺不再等待）
+    QString changeSettledCondition() const;
+    bool ensureColumn(const QString &table, const QString &column, const QString &definition);
+    bool storeUpload(const QString &filePath, QVariant &hash, qint64 &size);
+
+    bool logChange(const QString &serialNumber);
+    bool adjustRemaining(const QString &serialNumber, int delta);
+    void reloadSerial(const QString &serialNumber, SerialRecord &record);
+    bool commitChange(const QString &serialNumber);
+    bool loadSerialsWhere(const QStringList &serialNumbers, QVector<SerialRecord> &serials);
+    bool removeCachedSerials(const QStringList &serialNumbers, QSet<QString> &releasedHashes);
+    bool loadActivationsWhere(const QStringList &serialNumbers,
+                              QHash<QString, QVector<ActivationRecord>> &activations);
+
+    bool fail(const QString &message);
+    bool rollback(const QString &message);
+};
+
+#endif // ACTIVATIONSTORE_H
@@ -0,0 +1,596 @@
+#include "benchmark.h"
+#include "activationstore.h"
+#include "csvparser.h"
+#include "trigramindex.h"
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QSqlDatabase>
+#include <QElapsedTimer>
+#include <QAtomicInt>
+#include <QtConcurrent>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// 基准数据的连接名，并发测试的线程在其后加序号
+const char *const ConnectionName = "kylin_bench";
+
+// 每个序列号预留的剩余激活次数，修改测试中添加激活信息时使用
+const int SpareActivations = 10;
+
+// 参与 CSV 解析测试的文件数上限
+const int MaxCsvFiles = 1000;
+
+// 固定种子的伪随机数（xorshift32），各平台生成的数据相同
+class Random
+{
+public:
+    explicit Random(quint32 seed) : state(seed ? seed : 0x9e3779b9u) {}
+
+    quint32 next()
+    {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+    }
+
+    int bounded(int n)
+    {
+        return int(next() % quint32(n));
+    }
+
+private:
+    quint32 state;
+};
+
+QString serialNumber(const char *prefix, int index)
+{
+    return QString("%1%2").arg(QLatin1String(prefix)).arg(index, 8, 10, QLatin1Char('0'));
+}
+
+// 与厂商文件相近：5 组 5 个大写字母或数字
+QString activationCode(Random &random)
+{
+    static const char alphabet[] = "ABCDEFGHJKLMNPQRSTUVWXYZ23456789";
+    QString code;
+    code.reserve(29);
+    for (int group = 0; group < 5; ++group) {
+        if (group > 0) {
+            code += QLatin1Char('-');
+        }
+        for (int i = 0; i < 5; ++i) {
+            code += QLatin1Char(alphabet[random.next() % 32]);
+        }
+    }
+    return code;
+}
+
+CSVData syntheticSerial(const QString &serial, int codes, Random &random)
+{
+    CSVData data;
+    data.serialNumber = serial;
+    data.totalActivations = codes + SpareActivations;
+    data.remainingActivations = SpareActivations;
+    data.activationCodes.reserve(codes);
+    for (int i = 0; i < codes; ++i) {
+        data.activationCodes.append(qMakePair(QString::number(random.next(), 16).toUpper(), activationCode(random)));
+    }
+    return data;
+}
+
+// 与厂商激活数据表相同的布局
+QByteArray csvContent(const CSVData &data)
+{
+    QByteArray content = "\xEF\xBB\xBF激活数据表,,,,\r\n";
+    content += "服务序列号," + data.serialNumber.toUtf8() + ",授权总数,"
+            + QByteArray::number(data.totalActivations) + ",\r\n";
+    content += "激活方式,扫码,可分配/可取消," + QByteArray::number(data.remainingActivations) + "/0,\r\n";
+    content += "\r\n注册码,激活码\r\n";
+    for (const auto &codePair : data.activationCodes) {
+        content += codePair.first.toUtf8() + ',' + codePair.second.toUtf8() + "\r\n";
+    }
+    return content;
+}
+
+// /proc/self/status 中的内存占用（KB），其他平台返回 0
+qint64 memoryKb(const char *key)
+{
+    QFile file("/proc/self/status");
+    if (!file.open(QIODevice::ReadOnly)) {
+        return 0;
+    }
+    for (const QByteArray &line : file.readAll().split('\n')) {
+        if (line.startsWith(key)) {
+            return line.mid(int(qstrlen(key))).trimmed().split(' ').value(0).toLongLong();
+        }
+    }
+    return 0;
+}
+
+// 丢弃写入内容，只用于测导出本身的耗时
+class NullDevice : public QIODevice
+{
+protected:
+    qint64 readData(char *, qint64) override { return -1; }
+    qint64 writeData(const char *, qint64 size) override { return size; }
+};
+
+DatabaseConfig benchConfig(const QString &databasePath)
+{
+    DatabaseConfig config;
+    config.driver = "QSQLITE";
+    config.databaseName = databasePath;
+    // 并发测试中各线程等待写锁，而不是立即失败
+    config.connectOptions = "QSQLITE_BUSY_TIMEOUT=10000";
+    return config;
+}
+
+} // namespace
+
+Benchmark::Benchmark(const Options &options, const Output &output)
+    : options(options),
+      output(output)
+{
+}
+
+bool Benchmark::run(bool &consistent)
+{
+    error.clear();
+    consistent = true;
+    for (const Size &size : options.sizes) {
+        if (!runSize(size, consistent)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+QString Benchmark::lastError() const
+{
+    return error;
+}
+
+bool Benchmark::parseSizes(const QString &text, QVector<Size> &sizes)
+{
+    sizes.clear();
+    for (const QString &item : text.split(',', QString::SkipEmptyParts)) {
+        const QStringList parts = item.trimmed().toLower().split('x');
+        bool serialsOk = false;
+        bool codesOk = false;
+        Size size;
+        size.serials = parts.value(0).toInt(&serialsOk);
+        size.codesPerSerial = parts.value(1).toInt(&codesOk);
+        if (parts.size() != 2 || !serialsOk || !codesOk || size.serials <= 0 || size.codesPerSerial < 0) {
+            return false;
+        }
+        sizes.append(size);
+    }
+    return !sizes.isEmpty();
+}
+
+bool Benchmark::runSize(const Size &size, bool &consistent)
+{
+    const QString label = QString("%1x%2").arg(size.serials).arg(size.codesPerSerial);
+    const QString dir = QDir(options.workDir).filePath(label);
+    QDir(dir).removeRecursively();
+    if (!QDir().mkpath(dir)) {
+        return fail("无法创建目录: " + dir);
+    }
+    const QString databasePath = dir + "/bench.sqlite";
+
+    bool ok = false;
+    {
+        QString openError;
+        QSqlDatabase db = ActivationStore::openDatabase(benchConfig(databasePath), ConnectionName, &openError);
+        ActivationStore store(db);
+        if (!openError.isEmpty() || !store.initSchema()) {
+            fail("无法创建基准数据库: " + (openError.isEmpty() ? store.lastError() : openError));
+        } else {
+            // 各项使用由种子派生的独立随机序列，增减某一项不影响其他项的数据
+            QVector<CSVData> parsed;
+            ok = benchParse(label, dir, qMin(size.serials, MaxCsvFiles), size.codesPerSerial, options.seed,
+                            parsed);
+            if (ok) {
+                // 解析出的文件按界面导入的方式逐个写入数据库
+                QElapsedTimer timer;
+                timer.start();
+                int codes = 0;
+                for (const CSVData &data : parsed) {
+                    if (!store.importCsv(data)) {
+                        ok = fail("导入失败: " + store.lastError());
+                        break;
+                    }
+                    codes += data.activationCodes.size();
+                }
+                if (ok) {
+                    QJsonObject extra;
+                    extra["codes"] = codes;
+                    report(label, "import_files", parsed.size(), timer.nsecsElapsed(), extra);
+                }
+            }
+            ok = ok && benchImport(label, store, size, options.seed + 1)
+                    && benchReads(label, store, size, options.seed + 2)
+                    && benchMutations(label, store, size, options.seed + 3)
+                    && (options.stressThreads <= 0 || benchStress(label, databasePath, store, consistent));
+            store.logStatementStats();
+        }
+        db.close();
+    }
+    QSqlDatabase::removeDatabase(ConnectionName);
+    return ok;
+}
+
+bool Benchmark::benchParse(const QString &label, const QString &dir, int files, int codes, quint32 seed,
+                           QVector<CSVData> &parsed)
+{
+    Random random(seed);
+    QStringList filePaths;
+    qint64 bytes = 0;
+    for (int i = 0; i < files; ++i) {
+        const QByteArray content = csvContent(syntheticSerial(serialNumber("CSV", i), codes, random));
+        const QString filePath = QString("%1/%2.csv").arg(dir).arg(i, 6, 10, QLatin1Char('0'));
+        QFile file(filePath);
+        if (!file.open(QIODevice::WriteOnly) || file.write(content) != content.size()) {
+            return fail("无法写入CSV文件: " + file.errorString());
+        }
+        filePaths.append(filePath);
+        bytes += content.size();
+    }
+
+    QJsonObject extra;
+    extra["bytes"] = double(bytes);
+
+    // 逐个解析（单个文件的解析速度）
+    QElapsedTimer timer;
+    timer.start();
+    for (const QString &filePath : filePaths) {
+        if (CsvParser::parseFile(filePath).serialNumber.isEmpty()) {
+            return fail("解析CSV文件失败: " + filePath);
+        }
+    }
+    report(label, "parse_csv", files, timer.nsecsElapsed(), extra);
+
+    // 与界面导入相同，在线程池中并行解析
+    timer.restart();
+    const QList<CSVData> results = QtConcurrent::blockingMapped(filePaths, &CsvParser::parseFile);
+    report(label, "parse_csv_parallel", files, timer.nsecsElapsed(), extra);
+
+    parsed = results.toVector();
+    return true;
+}
+
+bool Benchmark::benchImport(const QString &label, ActivationStore &store, const Size &size, quint32 seed)
+{
+    // 每次生成一个序列号的数据，只对导入计时，内存与规模无关
+    Random random(seed);
+    qint64 nsecs = 0;
+    QElapsedTimer timer;
+    for (int i = 0; i < size.serials; ++i) {
+        const CSVData data = syntheticSerial(serialNumber("BENCH", i), size.codesPerSerial, random);
+        timer.start();
+        if (!store.importCsv(data)) {
+            return fail("导入失败: " + store.lastError());
+        }
+        nsecs += timer.nsecsElapsed();
+    }
+    QJsonObject extra;
+    extra["codes"] = double(qint64(size.serials) * size.codesPerSerial);
+    report(label, "import_serials", size.serials, nsecs, extra);
+    return true;
+}
+
+bool Benchmark::benchReads(const QString &label, ActivationStore &store, const Size &size, quint32 seed)
+{
+    Random random(seed);
+    const int queries = options.queries;
+    QElapsedTimer timer;
+
+    // 启动时的首页
+    SerialPage page;
+    timer.start();
+    for (int i = 0; i < queries; ++i) {
+        if (!store.loadSerialPage(QString(), 100, page)) {
+            return fail(store.lastError());
+        }
+    }
+    report(label, "load_first_page", queries, timer.nsecsElapsed());
+
+    // 滚动加载全部主行，同时取出全部激活码用于内存中的搜索
+    QStringList codes;
+    qint64 pages = 0;
+    qint64 rows = 0;
+    qint64 activationNsecs = 0;
+    QElapsedTimer activationTimer;
+    QString after;
+    timer.restart();
+    do {
+        if (!store.loadSerialPage(after, 500, page)) {
+            return fail(store.lastError());
+        }
+        ++pages;
+        rows += page.serials.size();
+        if (!page.serials.isEmpty()) {
+            after = page.serials.last().serialNumber;
+        }
+
+        QStringList serialNumbers;
+        for (const SerialRecord &record : page.serials) {
+            serialNumbers.append(record.serialNumber);
+        }
+        QHash<QString, QVector<ActivationRecord>> activations;
+        activationTimer.start();
+        if (!store.loadActivations(serialNumbers, activations)) {
+            return fail(store.lastError());
+        }
+        activationNsecs += activationTimer.nsecsElapsed();
+        for (const QVector<ActivationRecord> &children : activations) {
+            for (const ActivationRecord &child : children) {
+                codes.append(child.activationCode);
+            }
+        }
+    } while (page.hasMore);
+    QJsonObject extra;
+    extra["rows"] = double(rows);
+    report(label, "load_all_serials", pages, timer.nsecsElapsed() - activationNsecs, extra);
+    extra["rows"] = codes.size();
+    report(label, "load_all_activations", pages, activationNsecs, extra);
+
+    // 展开单个主行
+    QVector<ActivationRecord> children;
+    timer.restart();
+    for (int i = 0; i < queries; ++i) {
+        if (!store.loadActivations(serialNumber("BENCH", random.bounded(size.serials)), children)) {
+            return fail(store.lastError());
+        }
+    }
+    report(label, "load_activations", queries, timer.nsecsElapsed());
+
+    // 服务器端搜索
+    SearchPage searchPage;
+    timer.restart();
+    for (int i = 0; i < queries; ++i) {
+        const QString prefix = serialNumber("BENCH", random.bounded(size.serials)).left(10);
+        if (!store.searchSerials("serial_number", prefix, ActivationStore::PrefixMatch, 0, 200, searchPage)) {
+            return fail(store.lastError());
+        }
+    }
+    report(label, "search_prefix", queries, timer.nsecsElapsed());
+
+    QStringList needles;
+    for (int i = 0; i < queries && !codes.isEmpty(); ++i) {
+        needles.append(codes.at(random.bounded(codes.size())).mid(6, 5));
+    }
+    timer.restart();
+    for (const QString &needle : needles) {
+        if (!store.searchSerials("activation_code", needle, ActivationStore::SubstringMatch, 0, 200,
+                                 searchPage)) {
+            return fail(store.lastError());
+        }
+    }
+    report(label, "search_substring", needles.size(), timer.nsecsElapsed());
+
+    // 界面中已加载数据的搜索：三字符索引
+    TrigramIndex index;
+    timer.restart();
+    for (int i = 0; i < codes.size(); ++i) {
+        index.insert(quint32(i), codes.at(i));
+    }
+    extra["rows"] = codes.size();
+    report(label, "trigram_build", codes.size(), timer.nsecsElapsed(), extra);
+
+    QVector<quint32> ids;
+    qint64 matches = 0;
+    timer.restart();
+    for (const QString &needle : needles) {
+        index.candidates(needle, ids);
+        for (quint32 id : ids) {
+            matches += codes.at(int(id)).contains(needle, Qt::CaseInsensitive) ? 1 : 0;
+        }
+    }
+    QJsonObject searchExtra;
+    searchExtra["matches"] = double(matches);
+    report(label, "trigram_search", needles.size(), timer.nsecsElapsed(), searchExtra);
+
+    // 批量导出
+    for (ExportOptions::Format format : {ExportOptions::Csv, ExportOptions::Ndjson}) {
+        ExportOptions exportOptions;
+        exportOptions.format = format;
+        ExportSummary summary;
+        NullDevice device;
+        device.open(QIODevice::WriteOnly);
+        timer.restart();
+        if (!store.exportData(exportOptions, &device, DataExporter::Progress(), summary)) {
+            return fail(store.lastError());
+        }
+        QJsonObject exportExtra;
+        exportExtra["bytes"] = double(summary.bytes);
+        report(label, format == ExportOptions::Csv ? "export_csv" : "export_ndjson", summary.rows,
+               timer.nsecsElapsed(), exportExtra);
+    }
+    return true;
+}
+
+bool Benchmark::benchMutations(const QString &label, ActivationStore &store, const Size &size, quint32 seed)
+{
+    // 每个序列号预留了 SpareActivations 次，添加后随即删除，剩余次数不会耗尽
+    Random random(seed);
+    const int operations = options.queries;
+    qint64 addNsecs = 0;
+    qint64 updateNsecs = 0;
+    qint64 deleteNsecs = 0;
+    qint64 serialNsecs = 0;
+    QElapsedTimer timer;
+    SerialRecord updated;
+
+    for (int i = 0; i < operations; ++i) {
+        const QString serial = serialNumber("BENCH", random.bounded(size.serials));
+        ActivationRecord record;
+        record.activationCode = QString("BENCH-ADD-%1").arg(i);
+
+        timer.start();
+        if (!store.addActivation(serial, record, updated)) {
+            return fail(store.lastError());
+        }
+        addNsecs += timer.nsecsElapsed();
+
+        timer.start();
+        if (!store.updateActivationColumn(serial, record.activationCode, "project_number", QString::number(i))) {
+            return fail(store.lastError());
+        }
+        updateNsecs += timer.nsecsElapsed();
+
+        timer.start();
+        if (!store.deleteActivation(serial, record.activationCode, updated)) {
+            return fail(store.lastError());
+        }
+        deleteNsecs += timer.nsecsElapsed();
+
+        timer.start();
+        if (!store.updateSerialColumn(serial, "bind_person", QString("bench%1").arg(i), updated.version, updated)) {
+            return fail(store.lastError());
+        }
+        serialNsecs += timer.nsecsElapsed();
+    }
+    report(label, "add_activation", operations, addNsecs);
+    report(label, "update_activation", operations, updateNsecs);
+    report(label, "delete_activation", operations, deleteNsecs);
+    report(label, "update_serial", operations, serialNsecs);
+    return true;
+}
+
+bool Benchmark::benchStress(const QString &label, const QString &databasePath, ActivationStore &store,
+                            bool &consistent)
+{
+    if (options.stressDatabase.driver.isEmpty()) {
+        return runStress(label, benchConfig(databasePath), store, serialNumber("STRESS", 0), consistent);
+    }
+
+    // 在配置的服务器上测试：用不会与真实数据重复的序列号，结束后删除
+    const QString connectionName = QString("%1_stress").arg(QLatin1String(ConnectionName));
+    bool ok = false;
+    {
+        QString openError;
+        QSqlDatabase db = ActivationStore::openDatabase(options.stressDatabase, connectionName, &openError);
+        ActivationStore serverStore(db);
+        if (!openError.isEmpty() || !serverStore.initSchema()) {
+            ok = fail("无法连接并发测试数据库: " + (openError.isEmpty() ? serverStore.lastError() : openError));
+        } else {
+            const QString serial = QString("BENCH-STRESS-%1").arg(QDateTime::currentMSecsSinceEpoch());
+            ok = runStress(label, options.stressDatabase, serverStore, serial, consistent);
+            if (!serverStore.deleteSerial(serial)) {
+                qDebug() << "删除并发测试数据失败:" << serverStore.lastError();
+            }
+        }
+        db.close();
+    }
+    QSqlDatabase::removeDatabase(connectionName);
+    return ok;
+}
+
+bool Benchmark::runStress(const QString &label, const DatabaseConfig &config, ActivationStore &store,
+                          const QString &serial, bool &consistent)
+{
+    // 多个连接同时对同一个序列号增删激活信息：剩余次数在数据库中原子加减，
+    // 结束后剩余次数和激活信息条数必须与各线程成功的操作数一致，否则说明有更新丢失
+    const int threads = options.stressThreads;
+    const int operations = options.stressOperations;
+    CSVData data;
+    data.serialNumber = serial;
+    data.totalActivations = threads * operations;
+    data.remainingActivations = threads * operations;
+    if (!store.importCsv(data)) {
+        return fail("导入失败: " + store.lastError());
+    }
+
+    QAtomicInt adds(0);
+    QAtomicInt deletes(0);
+    QAtomicInt failures(0);
+    QElapsedTimer timer;
+    timer.start();
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([t, operations, &config, &data, &adds, &deletes, &failures]() {
+            const QString connectionName = QString("%1_%2").arg(QLatin1String(ConnectionName)).arg(t);
+            {
+                QSqlDatabase db = ActivationStore::openDatabase(config, connectionName);
+                ActivationStore worker(db);
+                SerialRecord updated;
+                for (int i = 0; i < operations; ++i) {
+                    ActivationRecord record;
+                    record.activationCode = QString("STRESS-%1-%2").arg(t).arg(i);
+                    if (!worker.addActivation(data.serialNumber, record, updated)) {
+                        failures.ref();
+                        continue;
+                    }
+                    adds.ref();
+                    if (!worker.deleteActivation(data.serialNumber, record.activationCode, updated)) {
+                        failures.ref();
+                        continue;
+                    }
+                    deletes.ref();
+                }
+                db.close();
+            }
+            QSqlDatabase::removeDatabase(connectionName);
+        });
+    }
+    for (std::thread &worker : workers) {
+        worker.join();
+    }
+    const qint64 nsecs = timer.nsecsElapsed();
+
+    QVector<SerialRecord> serials;
+    QVector<ActivationRecord> children;
+    if (!store.loadSerials(QStringList() << data.serialNumber, serials) || serials.isEmpty()
+            || !store.loadActivations(data.serialNumber, children)) {
+        return fail("读取并发测试结果失败: " + store.lastError());
+    }
+    const int expectedRemaining = data.remainingActivations - adds.load() + deletes.load();
+    const int expectedActivations = adds.load() - deletes.load();
+    const bool ok = serials.first().remainingActivations == expectedRemaining
+            && children.size() == expectedActivations;
+    consistent = consistent && ok;
+
+    // SQLite 上所有写入串行执行，一致只说明事务本身正确，不能证明行级并发下没有更新丢失
+    const bool sqlite = config.driver == "QSQLITE";
+    QJsonObject extra;
+    extra["backend"] = sqlite ? "sqlite" : "server";
+    if (sqlite) {
+        extra["note"] = "SQLite 写入串行执行，无法发现行级并发更新丢失；用 --stress-server 在 MySQL 上测试";
+    }
+    extra["threads"] = threads;
+    extra["adds"] = adds.load();
+    extra["deletes"] = deletes.load();
+    extra["failures"] = failures.load();
+    extra["remaining"] = serials.first().remainingActivations;
+    extra["expected_remaining"] = expectedRemaining;
+    extra["activations"] = children.size();
+    extra["expected_activations"] = expectedActivations;
+    extra["consistent"] = ok;
+    report(label, "stress_add_delete", adds.load() + deletes.load(), nsecs, extra);
+    return true;
+}
+
+void Benchmark::report(const QString &label, const QString &operation, qint64 count, qint64 nsecs,
+                       const QJsonObject &extra)
+{
+    QJsonObject line = extra;
+    line["size"] = label;
+    line["operation"] = operation;
+    line["count"] = double(count);
+    line["total_ms"] = double(nsecs) / 1e6;
+    line["per_op_us"] = count > 0 ? double(nsecs) / 1e3 / double(count) : 0.0;
+    line["rss_kb"] = double(memoryKb("VmRSS:"));
+    line["peak_rss_kb"] = double(memoryKb("VmHWM:"));
+    output(line);
+}
+
+bool Benchmark::fail(const QString &message)
+{
+    error = message;
+    return false;
+}
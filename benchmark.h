@@ -0,0 +1,66 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <QJsonObject>
+#include <QString>
+#include <QVector>
+#include <functional>
+#include "activationstore.h"
+
+// 合成数据基准测试（命令行 bench）
+// 用固定种子生成 N 个序列号、每个 M 个激活码的 SQLite 数据库和同样格式的 CSV 文件，
+// 不访问网络；对加载、搜索、解析、导入、导出和修改各路径计时，
+// 每项输出一行 JSON（耗时、每次操作耗时、内存），相同参数的结果可以直接与之前的比较
+class Benchmark
+{
+public:
+    struct Size {
+        int serials;
+        int codesPerSerial;
+    };
+
+    struct Options {
+        QVector<Size> sizes;
+        QString workDir;           // 生成的数据库和 CSV 文件放在此目录下
+        quint32 seed = 1;
+        int queries = 200;         // 单条查询类操作的次数
+        int stressThreads = 4;     // 并发增删激活信息的线程数，0 表示不做
+        int stressOperations = 200;
+        // 并发测试使用的数据库；driver 为空时用生成的 SQLite 数据库，
+        // 但 SQLite 的写事务串行执行，只有在 MySQL 上才能发现行级的并发更新丢失
+        DatabaseConfig stressDatabase;
+    };
+
+    typedef std::function<void(const QJsonObject &)> Output;
+
+    Benchmark(const Options &options, const Output &output);
+
+    // 并发测试发现剩余次数与激活信息条数不一致时 consistent 为 false
+    bool run(bool &consistent);
+    QString lastError() const;
+
+    // "1000x10,10000x20" 形式的规模列表
+    static bool parseSizes(const QString &text, QVector<Size> &sizes);
+
+private:
+    Options options;
+    Output output;
+    QString error;
+
+    bool runSize(const Size &size, bool &consistent);
+    bool benchParse(const QString &label, const QString &dir, int files, int codes, quint32 seed,
+                    QVector<CSVData> &parsed);
+    bool benchImport(const QString &label, ActivationStore &store, const Size &size, quint32 seed);
+    bool benchReads(const QString &label, ActivationStore &store, const Size &size, quint32 seed);
+    bool benchMutations(const QString &label, ActivationStore &store, const Size &size, quint32 seed);
+    bool benchStress(const QString &label, const QString &databasePath, ActivationStore &store,
+                     bool &consistent);
+    bool runStress(const QString &label, const DatabaseConfig &config, ActivationStore &store,
+                   const QString &serial, bool &consistent);
+
+    void report(const QString &label, const QString &operation, qint64 count, qint64 nsecs,
+                const QJsonObject &extra = QJsonObject());
+    bool fail(const QString &message);
+};
+
+#endif // BENCHMARK_H
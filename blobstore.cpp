@@ -0,0 +1,517 @@
+#include "blobstore.h"
+#include "querymonitor.h"
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QVariant>
+#include <QIODevice>
+#include <QBuffer>
+#include <QCryptographicHash>
+#include <QDebug>
+#include <QtEndian>
+#include <cstring>
+#ifdef KYLIN_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+// 压缩块的格式头：8 字节标识 + 1 字节压缩格式 + 4 字节原始长度（大端）
+static const char ChunkMagic[] = "\x89KYLNZ\r\n";
+static const int ChunkMagicSize = 8;
+static const int ChunkHeaderSize = ChunkMagicSize + 1 + 4;
+
+BlobStore::BlobStore(const QSqlDatabase &db)
+    : db(db),
+      compression(true),
+      storedBytes(0)
+{
+}
+
+void BlobStore::setCompression(bool enabled)
+{
+    compression = enabled;
+}
+
+BlobStore::Codec BlobStore::preferredCodec()
+{
+#ifdef KYLIN_HAVE_ZSTD
+    return ZstdCodec;
+#else
+    return ZlibCodec;
+#endif
+}
+
+QByteArray BlobStore::encodeChunk(const QByteArray &data, bool compress)
+{
+    const bool looksEncoded = data.startsWith(QByteArray::fromRawData(ChunkMagic, ChunkMagicSize));
+    Codec codec = NoCodec;
+    QByteArray payload;
+
+    if (compress) {
+        codec = preferredCodec();
+#ifdef KYLIN_HAVE_ZSTD
+        payload.resize(int(ZSTD_compressBound(size_t(data.size()))));
+        size_t length = ZSTD_compress(payload.data(), size_t(payload.size()), data.constData(),
+                                      size_t(data.size()), 3);
+        if (ZSTD_isError(length)) {
+            payload.clear();
+        } else {
+            payload.resize(int(length));
+        }
+#else
+        payload = qCompress(data);
+#endif
+        // 压缩后没有变小的块按原样保存
+        if (payload.isEmpty() || payload.size() + ChunkHeaderSize >= data.size()) {
+            codec = NoCodec;
+        }
+    }
+
+    if (codec == NoCodec) {
+        // 原始内容恰好以格式头开头时也加上头，避免读取时误判
+        if (!looksEncoded) {
+            return data;
+        }
+        payload = data;
+    }
+
+    QByteArray stored(ChunkHeaderSize, Qt::Uninitialized);
+    std::memcpy(stored.data(), ChunkMagic, ChunkMagicSize);
+    stored[ChunkMagicSize] = char(codec);
+    qToBigEndian<quint32>(quint32(data.size()), reinterpret_cast<uchar *>(stored.data() + ChunkMagicSize + 1));
+    stored += payload;
+    return stored;
+}
+
+bool BlobStore::decodeChunk(const QByteArray &stored, QByteArray &data)
+{
+    if (!stored.startsWith(QByteArray::fromRawData(ChunkMagic, ChunkMagicSize))
+        || stored.size() < ChunkHeaderSize) {
+        data = stored;  // 旧的未压缩块
+        return true;
+    }
+
+    const Codec codec = Codec(quint8(stored.at(ChunkMagicSize)));
+    const quint32 length = qFromBigEndian<quint32>(reinterpret_cast<const uchar *>(stored.constData() + ChunkMagicSize + 1));
+    const char *payload = stored.constData() + ChunkHeaderSize;
+    const int payloadSize = stored.size() - ChunkHeaderSize;
+
+    switch (codec) {
+    case NoCodec:
+        data = QByteArray(payload, payloadSize);
+        break;
+    case ZlibCodec:
+        data = qUncompress(reinterpret_cast<const uchar *>(payload), payloadSize);
+        break;
+    case ZstdCodec:
+#ifdef KYLIN_HAVE_ZSTD
+    {
+        data.resize(int(length));
+        size_t result = ZSTD_decompress(data.data(), length, payload, size_t(payloadSize));
+        if (ZSTD_isError(result)) {
+            return false;
+        }
+        data.resize(int(result));
+        break;
+    }
+#else
+        qDebug() << "未启用 zstd 支持，无法解压";
+        return false;
+#endif
+    default:
+        return false;
+    }
+    return quint32(data.size()) == length;
+}
+
+QString BlobStore::sizeColumns()
+{
+    // 优先取 blobs 表中记录的大小；旧版内嵌内容用 LENGTH()，NULL 视为 0
+    return "COALESCE((SELECT b.size FROM blobs b WHERE b.hash = serial_numbers.license_hash), "
+           "LENGTH(serial_numbers.license_file), 0) AS license_size, "
+           "COALESCE((SELECT b.size FROM blobs b WHERE b.hash = serial_numbers.kyinfo_hash), "
+           "LENGTH(serial_numbers.kyinfo_file), 0) AS kyinfo_size";
+}
+
+QString BlobStore::columnName(Kind kind)
+{
+    return kind == License ? "license_file" : "kyinfo_file";
+}
+
+QString BlobStore::hashColumnName(Kind kind)
+{
+    return kind == License ? "license_hash" : "kyinfo_hash";
+}
+
+bool BlobStore::initSchema()
+{
+    error.clear();
+    QSqlQuery query(db);
+
+    const QString blobType = isSqlite() ? "BLOB" : "MEDIUMBLOB";
+    if (!QueryMonitor::exec(query, "CREATE TABLE IF NOT EXISTS blobs ("
+                                   "hash CHAR(64) PRIMARY KEY, "
+                                   "size BIGINT NOT NULL, "
+                                   "chunk_count INT NOT NULL)")) {
+        return fail("创建blobs表失败: " + query.lastError().text());
+    }
+    if (!QueryMonitor::exec(query, "CREATE TABLE IF NOT EXISTS blob_chunks ("
+                                   "hash CHAR(64) NOT NULL, "
+                                   "seq INT NOT NULL, "
+                                   "data " + blobType + " NOT NULL, "
+                                   "PRIMARY KEY (hash, seq))")) {
+        return fail("创建blob_chunks表失败: " + query.lastError().text());
+    }
+    return true;
+}
+
+bool BlobStore::store(QIODevice *source, QString &hash, qint64 &size)
+{
+    error.clear();
+
+    // 第一遍：流式计算哈希
+    if (!source->seek(0)) {
+        return fail("无法读取文件: " + source->errorString());
+    }
+    QCryptographicHash hasher(QCryptographicHash::Sha256);
+    if (!hasher.addData(source)) {
+        return fail("读取文件失败: " + source->errorString());
+    }
+    hash = QString::fromLatin1(hasher.result().toHex());
+    size = source->pos();
+    const int chunkCount = int((size + ChunkSize - 1) / ChunkSize);
+
+    // 已有相同内容时直接引用；并发写入同一内容时由主键保证只写一份
+    QSqlQuery query(db);
+    query.prepare(QString(isSqlite() ? "INSERT OR IGNORE" : "INSERT IGNORE")
+                  + " INTO blobs (hash, size, chunk_count) VALUES (?, ?, ?)");
+    query.addBindValue(hash);
+    query.addBindValue(size);
+    query.addBindValue(chunkCount);
+    if (!QueryMonitor::exec(query)) {
+        return fail("保存文件失败: " + query.lastError().text());
+    }
+    if (query.numRowsAffected() == 0) {
+        // 锁住已有的内容行，直到本事务提交前 release() 不能删除它（SQLite 写事务本身互斥）
+        if (!isSqlite()) {
+            query.prepare("SELECT hash FROM blobs WHERE hash = ? FOR UPDATE");
+            query.addBindValue(hash);
+            if (!QueryMonitor::exec(query)) {
+                return fail("保存文件失败: " + query.lastError().text());
+            }
+        }
+        if (isComplete(hash)) {
+            return true;
+        }
+        // 只登记了大小或写了一部分块（本地缓存），清掉后重新写入
+        query.prepare("DELETE FROM blob_chunks WHERE hash = ?");
+        query.addBindValue(hash);
+        if (!QueryMonitor::exec(query)) {
+            return fail("保存文件失败: " + query.lastError().text());
+        }
+    }
+
+    // 第二遍：按块写入
+    if (!source->seek(0)) {
+        return fail("无法读取文件: " + source->errorString());
+    }
+    query.prepare("INSERT INTO blob_chunks (hash, seq, data) VALUES (?, ?, ?)");
+    for (int seq = 0; seq < chunkCount; ++seq) {
+        const QByteArray chunk = source->read(ChunkSize);
+        if (chunk.isEmpty()) {
+            return fail("读取文件失败: " + source->errorString());
+        }
+        query.bindValue(0, hash);
+        query.bindValue(1, seq);
+        query.bindValue(2, encodeChunk(chunk, compression));
+        if (!QueryMonitor::exec(query)) {
+            return fail("保存文件失败: " + query.lastError().text());
+        }
+    }
+    return true;
+}
+
+bool BlobStore::read(const QString &serialNumber, Kind kind, QIODevice *sink, qint64 *written)
+{
+    error.clear();
+    storedBytes = 0;
+    if (written) {
+        *written = 0;
+    }
+
+    QSqlQuery query(db);
+    query.prepare(QString("SELECT %1, %2 IS NULL FROM serial_numbers WHERE serial_number = ?")
+                  .arg(hashColumnName(kind), columnName(kind)));
+    query.addBindValue(serialNumber);
+    if (!QueryMonitor::exec(query)) {
+        return fail(query.lastError().text());
+    }
+    if (!query.next()) {
+        return true;
+    }
+
+    const QString hash = query.value(0).toString();
+    if (!hash.isEmpty()) {
+        return readHash(hash, sink, written);
+    }
+    if (query.value(1).toBool()) {
+        return true;
+    }
+
+    // 尚未迁移的旧版内嵌内容
+    query.prepare(QString("SELECT %1 FROM serial_numbers WHERE serial_number = ?").arg(columnName(kind)));
+    query.addBindValue(serialNumber);
+    if (!QueryMonitor::exec(query) || !query.next()) {
+        return fail(query.lastError().text());
+    }
+    const QByteArray data = query.value(0).toByteArray();
+    storedBytes = data.size();
+    if (sink->write(data) != data.size()) {
+        return fail("写入文件失败: " + sink->errorString());
+    }
+    if (written) {
+        *written = data.size();
+    }
+    return true;
+}
+
+bool BlobStore::readHash(const QString &hash, QIODevice *sink, qint64 *written)
+{
+    QSqlQuery query(db);
+    query.prepare("SELECT chunk_count FROM blobs WHERE hash = ?");
+    query.addBindValue(hash);
+    if (!QueryMonitor::exec(query)) {
+        return fail(query.lastError().text());
+    }
+    if (!query.next()) {
+        return fail("文件内容缺失: " + hash);
+    }
+    const int chunkCount = query.value(0).toInt();
+
+    // 逐块查询，驱动每次只缓存一块
+    query.prepare("SELECT data FROM blob_chunks WHERE hash = ? AND seq = ?");
+    for (int seq = 0; seq < chunkCount; ++seq) {
+        query.bindValue(0, hash);
+        query.bindValue(1, seq);
+        if (!QueryMonitor::exec(query)) {
+            return fail(query.lastError().text());
+        }
+        if (!query.next()) {
+            return fail(QString("文件内容缺失: %1 第 %2 块").arg(hash).arg(seq));
+        }
+        const QByteArray stored = query.value(0).toByteArray();
+        storedBytes += stored.size();
+        QByteArray chunk;
+        if (!decodeChunk(stored, chunk)) {
+            return fail(QString("文件内容损坏: %1 第 %2 块").arg(hash).arg(seq));
+        }
+        if (sink->write(chunk) != chunk.size()) {
+            return fail("写入文件失败: " + sink->errorString());
+        }
+        if (written) {
+            *written += chunk.size();
+        }
+    }
+    return true;
+}
+
+bool BlobStore::isComplete(const QString &hash)
+{
+    QSqlQuery query(db);
+    query.prepare("SELECT b.chunk_count, (SELECT COUNT(*) FROM blob_chunks c WHERE c.hash = b.hash) "
+                  "FROM blobs b WHERE b.hash = ?");
+    query.addBindValue(hash);
+    if (!QueryMonitor::exec(query) || !query.next()) {
+        return false;
+    }
+    return query.value(1).toInt() >= query.value(0).toInt();
+}
+
+bool BlobStore::release(const QString &hash)
+{
+    error.clear();
+    if (hash.isEmpty()) {
+        return true;
+    }
+
+    // 先锁住内容行，与同时引用这份内容的 store() 互斥；
+    // 引用按两个哈希列分别用索引查找，加锁读取能看到其他事务刚提交的引用
+    QSqlQuery query(db);
+    if (!isSqlite()) {
+        query.prepare("SELECT hash FROM blobs WHERE hash = ? FOR UPDATE");
+        query.addBindValue(hash);
+        if (!QueryMonitor::exec(query)) {
+            return fail(query.lastError().text());
+        }
+    }
+    for (Kind kind : {License, Kyinfo}) {
+        query.prepare(QString("SELECT 1 FROM serial_numbers WHERE %1 = ? LIMIT 1%2")
+                      .arg(hashColumnName(kind), isSqlite() ? "" : " LOCK IN SHARE MODE"));
+        query.addBindValue(hash);
+        if (!QueryMonitor::exec(query)) {
+            return fail(query.lastError().text());
+        }
+        if (query.next()) {
+            return true;
+        }
+    }
+
+    query.prepare("DELETE FROM blob_chunks WHERE hash = ?");
+    query.addBindValue(hash);
+    if (!QueryMonitor::exec(query)) {
+        return fail(query.lastError().text());
+    }
+    query.prepare("DELETE FROM blobs WHERE hash = ?");
+    query.addBindValue(hash);
+    if (!QueryMonitor::exec(query)) {
+        return fail(query.lastError().text());
+    }
+    return true;
+}
+
+int BlobStore::migrateInline()
+{
+    error.clear();
+    int migrated = 0;
+
+    for (Kind kind : {License, Kyinfo}) {
+        const QString column = columnName(kind);
+        const QString hashColumn = hashColumnName(kind);
+
+        QStringList serialNumbers;
+        QSqlQuery query(db);
+        const QString sql = QString("SELECT serial_number FROM serial_numbers WHERE %1 IS NOT NULL AND %2 IS NULL")
+                .arg(column, hashColumn);
+        if (!QueryMonitor::exec(query, sql)) {
+            fail(query.lastError().text());
+            return migrated;
+        }
+        while (query.next()) {
+            serialNumbers.append(query.value(0).toString());
+        }
+
+        // 每个文件单独成事务，一次只有一个文件的内容在内存中
+        for (const QString &serialNumber : serialNumbers) {
+            db.transaction();
+            query.prepare(QString("SELECT %1 FROM serial_numbers WHERE serial_number = ?").arg(column));
+            query.addBindValue(serialNumber);
+            if (!QueryMonitor::exec(query) || !query.next()) {
+                db.rollback();
+                continue;
+            }
+            QByteArray data = query.value(0).toByteArray();
+            QBuffer buffer(&data);
+            buffer.open(QIODevice::ReadOnly);
+
+            QString hash;
+            qint64 size = 0;
+            if (data.isEmpty() || store(&buffer, hash, size)) {
+                query.prepare(QString("UPDATE serial_numbers SET %1 = ?, %2 = NULL WHERE serial_number = ?")
+                              .arg(hashColumn, column));
+                query.addBindValue(data.isEmpty() ? QVariant(QVariant::String) : QVariant(hash));
+                query.addBindValue(serialNumber);
+                if (QueryMonitor::exec(query) && db.commit()) {
+                    ++migrated;
+                    continue;
+                }
+            }
+            qDebug() << "迁移" << serialNumber << column << "失败:" << error << query.lastError().text();
+            db.rollback();
+        }
+    }
+    return migrated;
+}
+
+bool BlobStore::recompress(int batchSize, qint64 &bytesBefore, qint64 &bytesAfter, int &chunks)
+{
+    error.clear();
+    bytesBefore = 0;
+    bytesAfter = 0;
+    chunks = 0;
+
+    // 按 (hash, seq) 键集分批，每批一个事务，中断后可重新运行
+    QString lastHash;
+    int lastSeq = -1;
+    for (;;) {
+        QSqlQuery select(db);
+        select.setForwardOnly(true);
+        select.prepare("SELECT hash, seq, data FROM blob_chunks "
+                       "WHERE hash > ? OR (hash = ? AND seq > ?) ORDER BY hash, seq LIMIT ?");
+        select.addBindValue(lastHash);
+        select.addBindValue(lastHash);
+        select.addBindValue(lastSeq);
+        select.addBindValue(batchSize);
+        if (!QueryMonitor::exec(select)) {
+            return fail("读取文件块失败: " + select.lastError().text());
+        }
+
+        struct Pending {
+            QString hash;
+            int seq;
+            QByteArray data;
+        };
+        QVector<Pending> updates;
+        int rows = 0;
+        while (select.next()) {
+            ++rows;
+            lastHash = select.value(0).toString();
+            lastSeq = select.value(1).toInt();
+            const QByteArray stored = select.value(2).toByteArray();
+            bytesBefore += stored.size();
+
+            // 已有格式头的块不再处理
+            if (stored.startsWith(QByteArray::fromRawData(ChunkMagic, ChunkMagicSize))) {
+                bytesAfter += stored.size();
+                continue;
+            }
+            const QByteArray encoded = encodeChunk(stored, true);
+            bytesAfter += encoded.size();
+            if (encoded.size() < stored.size()) {
+                updates.append(Pending{lastHash, lastSeq, encoded});
+            }
+        }
+        if (rows == 0) {
+            break;
+        }
+
+        db.transaction();
+        QSqlQuery update(db);
+        update.prepare("UPDATE blob_chunks SET data = ? WHERE hash = ? AND seq = ?");
+        for (const Pending &pending : updates) {
+            update.bindValue(0, pending.data);
+            update.bindValue(1, pending.hash);
+            update.bindValue(2, pending.seq);
+            if (!QueryMonitor::exec(update)) {
+                db.rollback();
+                return fail("写入文件块失败: " + update.lastError().text());
+            }
+        }
+        if (!db.commit()) {
+            db.rollback();
+            return fail("提交失败: " + db.lastError().text());
+        }
+        chunks += updates.size();
+        qDebug() << "已重新压缩" << chunks << "块，存储" << bytesBefore << "->" << bytesAfter << "字节";
+    }
+    return true;
+}
+
+qint64 BlobStore::lastStoredBytes() const
+{
+    return storedBytes;
+}
+
+QString BlobStore::lastError() const
+{
+    return error;
+}
+
+bool BlobStore::isSqlite() const
+{
+    return db.driverName() == "QSQLITE";
+}
+
+bool BlobStore::fail(const QString &message)
+{
+    error = message;
+    qDebug() << message;
+    return false;
+}
@@ -0,0 +1,86 @@
+#ifndef BLOBSTORE_H
+#define BLOBSTORE_H
+
+#include <QSqlDatabase>
+#include <QByteArray>
+#include <QString>
+
+class QIODevice;
+
+// LICENSE / .kyinfo 文件存储
+// 文件内容按 SHA-256 去重存放在 blobs / blob_chunks 表中，序列号行只记录哈希；
+// 上传和下载都按固定大小的块进行，内存占用与文件大小无关。
+// 旧版本直接存放在 serial_numbers 中的文件内容仍可读取，并由 migrateInline() 迁移。
+// 每块可单独压缩（有 zstd 时用 zstd，否则用 qCompress），压缩块以格式头开头，
+// 没有格式头的块按原始内容读取
+class BlobStore
+{
+public:
+    enum Kind {
+        License,
+        Kyinfo
+    };
+
+    static const int ChunkSize = 256 * 1024;
+
+    // 块压缩格式
+    enum Codec {
+        NoCodec = 0,
+        ZlibCodec = 1,
+        ZstdCodec = 2
+    };
+
+    explicit BlobStore(const QSqlDatabase &db = QSqlDatabase::database());
+
+    // 列表查询使用的大小列（不传输文件内容）
+    static QString sizeColumns();
+    static QString columnName(Kind kind);      // 旧版内嵌内容列
+    static QString hashColumnName(Kind kind);  // 内容哈希列
+
+    bool initSchema();
+
+    // 写入时是否压缩（默认压缩）
+    void setCompression(bool enabled);
+    static Codec preferredCodec();
+
+    // 写入 source 的全部内容（source 须可重新定位），返回内容哈希和大小；
+    // 相同内容已存在时不再重复写入
+    bool store(QIODevice *source, QString &hash, qint64 &size);
+
+    // 把某个序列号的文件按块写入 sink，没有文件时 written 为 0
+    bool read(const QString &serialNumber, Kind kind, QIODevice *sink, qint64 *written = nullptr);
+
+    // 内容的所有块是否都已写入（本地缓存中可能只登记了大小）
+    bool isComplete(const QString &hash);
+
+    // 没有序列号引用时删除该内容；与 store() 在同一内容上互斥，
+    // 调用方须在删除或替换引用的同一事务中调用
+    bool release(const QString &hash);
+
+    // 把旧版内嵌在 serial_numbers 中的文件迁移到 blobs 表，返回迁移的文件数
+    int migrateInline();
+
+    // 把未压缩的块按批重新压缩，每批一个事务；返回处理前后的存储字节数
+    bool recompress(int batchSize, qint64 &bytesBefore, qint64 &bytesAfter, int &chunks);
+
+    // 最近一次 read() 从数据库读出的字节数（压缩后）
+    qint64 lastStoredBytes() const;
+
+    // 单块编解码
+    static QByteArray encodeChunk(const QByteArray &data, bool compress);
+    static bool decodeChunk(const QByteArray &stored, QByteArray &data);
+
+    QString lastError() const;
+
+private:
+    QSqlDatabase db;
+    QString error;
+    bool compression;
+    qint64 storedBytes;
+
+    bool isSqlite() const;
+    bool readHash(const QString &hash, QIODevice *sink, qint64 *written);
+    bool fail(const QString &message);
+};
+
+#endif // BLOBSTORE_H
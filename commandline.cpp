@@ -0,0 +1,494 @@
+#include "commandline.h"
+#include "csvparser.h"
+#include "querymonitor.h"
+#include <QCommandLineParser>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QSet>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QElapsedTimer>
+#include <QtConcurrent>
+#include <QStandardPaths>
+#include <cstdio>
+
+static const char *const ConnectionName = "kylin_cli";
+
+// 基准测试期间丢弃逐条的调试输出，只保留警告和错误
+static void quietMessageHandler(QtMsgType type, const QMessageLogContext &, const QString &message)
+{
+    if (type != QtDebugMsg && type != QtInfoMsg) {
+        fprintf(stderr, "%s\n", message.toLocal8Bit().constData());
+    }
+}
+
+static QJsonObject serialToJson(const SerialRecord &record)
+{
+    QJsonObject object;
+    object["serial_number"] = record.serialNumber;
+    object["total_activations"] = record.totalActivations;
+    object["remaining_activations"] = record.remainingActivations;
+    object["platform"] = record.platform;
+    object["verification_code"] = record.verificationCode;
+    object["bind_wechat"] = record.bindWechat;
+    object["bind_person"] = record.bindPerson;
+    object["license_size"] = double(record.licenseSize);
+    object["kyinfo_size"] = double(record.kyinfoSize);
+    object["version"] = record.version;
+    return object;
+}
+
+static QJsonArray activationsToJson(const QVector<ActivationRecord> &activations)
+{
+    QJsonArray array;
+    for (const ActivationRecord &activation : activations) {
+        QJsonObject object;
+        object["activation_code"] = activation.activationCode;
+        object["project_number"] = activation.projectNumber;
+        object["chassis_number"] = activation.chassisNumber;
+        array.append(object);
+    }
+    return array;
+}
+
+CommandLine::CommandLine()
+    : out(stdout),
+      err(stderr),
+      store(nullptr)
+{
+    out.setCodec("UTF-8");
+    err.setCodec("UTF-8");
+}
+
+int CommandLine::run(const QStringList &arguments)
+{
+    QCommandLineParser parser;
+    parser.addOption(QCommandLineOption("cli", "命令行模式"));
+    parser.addOption(QCommandLineOption("sqlite", "使用本地 SQLite 数据库文件", "path"));
+    parser.addOption(QCommandLineOption(QStringList() << "o" << "output", "导出文件（默认标准输出）", "file"));
+    parser.addOption(QCommandLineOption("format", "导出格式 csv 或 ndjson（默认按文件扩展名，标准输出为 ndjson）",
+                                        "format"));
+    parser.addOption(QCommandLineOption("fields", "导出的列，逗号分隔", "fields"));
+    parser.addOption(QCommandLineOption("filter", "按列前缀筛选，如 serial_number=KY", "column=prefix"));
+    parser.addOption(QCommandLineOption("sizes", "基准测试规模，如 1000x10,10000x20", "sizes", "1000x10,10000x20"));
+    parser.addOption(QCommandLineOption("dir", "基准测试数据目录", "dir"));
+    parser.addOption(QCommandLineOption("seed", "基准测试随机数种子", "seed", "1"));
+    parser.addOption(QCommandLineOption("queries", "基准测试中查询/修改的次数", "count", "200"));
+    parser.addOption(QCommandLineOption("stress-threads", "并发增删测试的线程数，0 表示不做", "count", "4"));
+    parser.addOption(QCommandLineOption("stress-ops", "并发增删测试中每个线程的操作数", "count", "200"));
+    parser.addOption(QCommandLineOption("stress-server", "并发增删测试改用配置的数据库服务器（测试数据结束后删除）"));
+    parser.addOption(QCommandLineOption("verbose", "输出调试信息"));
+    parser.addOption(QCommandLineOption(QStringList() << "h" << "help", "显示帮助"));
+    parser.addPositionalArgument("command", "import <目录或CSV文件...> | export | lookup <序列号...> | stats | explain");
+
+    if (!parser.parse(arguments)) {
+        return usage(parser.errorText());
+    }
+    if (parser.isSet("help")) {
+        return usage();
+    }
+
+    QStringList positional = parser.positionalArguments();
+    if (positional.isEmpty()) {
+        return usage("缺少命令");
+    }
+    const QString command = positional.takeFirst();
+
+    config = DatabaseConfig::defaultConfig();
+    if (parser.isSet("sqlite")) {
+        config.driver = "QSQLITE";
+        config.databaseName = parser.value("sqlite");
+        config.connectOptions.clear();
+    }
+    QueryMonitor::configure(config.slowQueryLog, config.slowQueryMs);
+
+    int code = UsageError;
+    if (command == "import") {
+        if (positional.isEmpty()) {
+            return usage("import 需要目录或CSV文件");
+        }
+        if (!openStore()) {
+            return DatabaseError;
+        }
+        code = importFiles(positional);
+    } else if (command == "export") {
+        // 先检查参数，参数有误时不连接数据库
+        ExportOptions options;
+        const QString outputPath = parser.value("output");
+        const QString format = parser.isSet("format") ? parser.value("format").toLower()
+                                                      : (outputPath.isEmpty() ? "ndjson" : QString());
+        if (format.isEmpty()) {
+            options.format = ExportOptions::formatForFile(outputPath);
+        } else if (format == "csv" || format == "ndjson") {
+            options.format = format == "csv" ? ExportOptions::Csv : ExportOptions::Ndjson;
+        } else {
+            return usage("不支持的导出格式: " + format);
+        }
+        if (parser.isSet("fields")) {
+            options.fields = parser.value("fields").split(',', QString::SkipEmptyParts);
+        }
+        if (parser.isSet("filter")) {
+            const QString filter = parser.value("filter");
+            const int equals = filter.indexOf('=');
+            if (equals <= 0) {
+                return usage("筛选条件格式应为 列=前缀");
+            }
+            options.filterColumn = filter.left(equals);
+            options.filterText = filter.mid(equals + 1);
+        }
+        if (!openStore()) {
+            return DatabaseError;
+        }
+        code = exportData(options, outputPath);
+    } else if (command == "lookup") {
+        if (positional.isEmpty()) {
+            return usage("lookup 需要序列号");
+        }
+        if (!openStore()) {
+            return DatabaseError;
+        }
+        code = lookup(positional);
+    } else if (command == "stats") {
+        if (!openStore()) {
+            return DatabaseError;
+        }
+        code = stats();
+    } else if (command == "explain") {
+        if (!openStore()) {
+            return DatabaseError;
+        }
+        code = explain();
+    } else if (command == "bench") {
+        // 使用自己生成的 SQLite 数据库，不连接服务器
+        Benchmark::Options options;
+        if (!Benchmark::parseSizes(parser.value("sizes"), options.sizes)) {
+            return usage("规模格式应为 序列号数x每个序列号的激活码数，如 1000x10");
+        }
+        options.workDir = parser.isSet("dir")
+                ? parser.value("dir")
+                : QDir(QStandardPaths::writableLocation(QStandardPaths::TempLocation)).filePath("kylin_bench");
+        options.seed = parser.value("seed").toUInt();
+        options.queries = qMax(1, parser.value("queries").toInt());
+        options.stressThreads = qMax(0, parser.value("stress-threads").toInt());
+        options.stressOperations = qMax(1, parser.value("stress-ops").toInt());
+        if (parser.isSet("stress-server")) {
+            options.stressDatabase = config;
+        }
+        return bench(options, parser.isSet("verbose"));
+    } else {
+        return usage("未知命令: " + command);
+    }
+
+    closeStore();
+    return code;
+}
+
+bool CommandLine::openStore()
+{
+    QString error;
+    db = ActivationStore::openDatabase(config, ConnectionName, &error);
+    store = new ActivationStore(db);
+    store->setImportChunkSize(config.importChunkSize);
+    store->setBlobCompression(config.compressBlobs);
+    if (error.isEmpty() && !store->initSchema()) {
+        error = store->lastError();
+    }
+    if (!error.isEmpty()) {
+        err << "无法连接数据库: " << error << endl;
+        closeStore();
+        return false;
+    }
+    return true;
+}
+
+void CommandLine::closeStore()
+{
+    if (store) {
+        store->logStatementStats();
+        QueryMonitor::logSummaries();
+    }
+    delete store;
+    store = nullptr;
+    db.close();
+    db = QSqlDatabase();
+    QSqlDatabase::removeDatabase(ConnectionName);
+}
+
+int CommandLine::importFiles(const QStringList &paths)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    // 参数可以是目录（取其中的 *.csv）或单个文件
+    QStringList filePaths;
+    for (const QString &path : paths) {
+        const QFileInfo info(path);
+        if (info.isDir()) {
+            QDir dir(path);
+            for (const QString &name : dir.entryList(QStringList() << "*.csv" << "*.CSV", QDir::Files, QDir::Name)) {
+                filePaths.append(dir.filePath(name));
+            }
+        } else {
+            filePaths.append(path);
+        }
+    }
+    filePaths.removeDuplicates();
+    if (filePaths.isEmpty()) {
+        err << "没有CSV文件" << endl;
+        return UsageError;
+    }
+
+    // 与界面相同：各文件在线程池中并行解析
+    const QList<CSVData> results = QtConcurrent::blockingMapped(filePaths, &CsvParser::parseFile);
+
+    QStringList serialNumbers;
+    for (const CSVData &data : results) {
+        if (!data.serialNumber.isEmpty()) {
+            serialNumbers.append(data.serialNumber);
+        }
+    }
+    QVector<SerialRecord> existing;
+    if (!store->loadSerials(serialNumbers, existing)) {
+        err << store->lastError() << endl;
+        return DatabaseError;
+    }
+    QSet<QString> existingSerials;
+    for (const SerialRecord &record : existing) {
+        existingSerials.insert(record.serialNumber);
+    }
+    QSet<QString> planned;
+
+    int imported = 0;
+    int failed = 0;
+    int skipped = 0;
+    for (int i = 0; i < results.size(); ++i) {
+        const CSVData &data = results.at(i);
+        QJsonObject line;
+        line["file"] = filePaths.at(i);
+        line["serial_number"] = data.serialNumber;
+        line["codes"] = data.activationCodes.size();
+
+        if (data.serialNumber.isEmpty()) {
+            line["status"] = "skipped";
+            line["reason"] = "格式不正确或没有有效数据";
+            ++skipped;
+        } else if (existingSerials.contains(data.serialNumber)) {
+            line["status"] = "skipped";
+            line["reason"] = "序列号已存在";
+            ++skipped;
+        } else if (planned.contains(data.serialNumber)) {
+            line["status"] = "skipped";
+            line["reason"] = "与其他文件重复";
+            ++skipped;
+        } else if (store->importCsv(data)) {
+            line["status"] = "imported";
+            planned.insert(data.serialNumber);
+            ++imported;
+        } else {
+            const QString error = store->lastError();
+            line["status"] = "failed";
+            line["error"] = error;
+            ++failed;
+            print(line);
+            if (!store->checkConnection()) {
+                err << "数据库连接已断开: " << store->lastError() << endl;
+                return DatabaseError;
+            }
+            continue;
+        }
+        print(line);
+    }
+
+    QJsonObject summary;
+    summary["summary"] = "import";
+    summary["files"] = filePaths.size();
+    summary["imported"] = imported;
+    summary["failed"] = failed;
+    summary["skipped"] = skipped;
+    summary["elapsed_ms"] = double(timer.elapsed());
+    print(summary);
+    return failed > 0 ? PartialFailure : Success;
+}
+
+int CommandLine::exportData(const ExportOptions &options, const QString &outputPath)
+{
+    // 输出到文件时先写临时文件，成功后再替换
+    QSaveFile file(outputPath);
+    QFile standardOutput;
+    QIODevice *device = &file;
+    if (outputPath.isEmpty()) {
+        out.flush();
+        standardOutput.open(stdout, QIODevice::WriteOnly);
+        device = &standardOutput;
+    } else if (!file.open(QIODevice::WriteOnly)) {
+        err << "无法写入文件: " << file.errorString() << endl;
+        return UsageError;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    ExportSummary summary;
+    if (!store->exportData(options, device, DataExporter::Progress(), summary)) {
+        err << store->lastError() << endl;
+        if (!outputPath.isEmpty()) {
+            file.cancelWriting();
+        }
+        return DatabaseError;
+    }
+    if (!outputPath.isEmpty() && !file.commit()) {
+        err << "无法写入文件: " << file.errorString() << endl;
+        return DatabaseError;
+    }
+    standardOutput.close();
+
+    QJsonObject line;
+    line["summary"] = "export";
+    line["serials"] = double(summary.serials);
+    line["rows"] = double(summary.rows);
+    line["bytes"] = double(summary.bytes);
+    line["elapsed_ms"] = double(timer.elapsed());
+    printTo(err, line);
+    return Success;
+}
+
+int CommandLine::lookup(const QStringList &serialNumbers)
+{
+    QVector<SerialRecord> serials;
+    QHash<QString, QVector<ActivationRecord>> activations;
+    if (!store->loadSerials(serialNumbers, serials) || !store->loadActivations(serialNumbers, activations)) {
+        err << store->lastError() << endl;
+        return DatabaseError;
+    }
+
+    QHash<QString, SerialRecord> found;
+    for (const SerialRecord &record : serials) {
+        found.insert(record.serialNumber, record);
+    }
+
+    // 按参数顺序输出，不存在的序列号也输出一行
+    int missing = 0;
+    for (const QString &serialNumber : serialNumbers) {
+        if (!found.contains(serialNumber)) {
+            QJsonObject object;
+            object["serial_number"] = serialNumber;
+            object["found"] = false;
+            print(object);
+            ++missing;
+            continue;
+        }
+        QJsonObject object = serialToJson(found.value(serialNumber));
+        object["found"] = true;
+        object["activations"] = activationsToJson(activations.value(serialNumber));
+        print(object);
+    }
+    return missing > 0 ? PartialFailure : Success;
+}
+
+int CommandLine::stats()
+{
+    StoreStatistics statistics;
+    if (!store->loadStatistics(statistics)) {
+        err << store->lastError() << endl;
+        return DatabaseError;
+    }
+
+    QJsonObject object;
+    object["driver"] = config.driver;
+    object["database"] = config.databaseName;
+    object["serials"] = double(statistics.serials);
+    object["activations"] = double(statistics.activations);
+    object["total_activations"] = double(statistics.totalActivations);
+    object["remaining_activations"] = double(statistics.remainingActivations);
+    object["change_cursor"] = double(statistics.changeCursor);
+    object["schema_version"] = statistics.schemaVersion;
+    print(object);
+    return Success;
+}
+
+int CommandLine::explain()
+{
+    QStringList report;
+    QStringList fullScans;
+    store->explainHotQueries(report, fullScans);
+
+    QJsonObject object;
+    object["plans"] = QJsonArray::fromStringList(report);
+    object["full_scans"] = QJsonArray::fromStringList(fullScans);
+    print(object);
+    return fullScans.isEmpty() ? Success : PartialFailure;
+}
+
+int CommandLine::bench(const Benchmark::Options &options, bool verbose)
+{
+    QtMessageHandler previous = nullptr;
+    if (!verbose) {
+        previous = qInstallMessageHandler(quietMessageHandler);
+    }
+
+    Benchmark benchmark(options, [this](const QJsonObject &line) {
+        print(line);
+        out.flush();
+    });
+    bool consistent = true;
+    const bool ok = benchmark.run(consistent);
+
+    // 各条语句的耗时分布，与各项操作的结果一起保存便于定位变慢的语句
+    for (const QueryMonitor::Summary &summary : QueryMonitor::summaries()) {
+        QJsonObject line;
+        line["operation"] = "sql";
+        line["sql"] = summary.sql;
+        line["count"] = double(summary.executions);
+        line["errors"] = double(summary.errors);
+        line["p50_ms"] = summary.p50Ms;
+        line["p95_ms"] = summary.p95Ms;
+        line["p99_ms"] = summary.p99Ms;
+        line["max_ms"] = summary.maxMs;
+        line["total_ms"] = summary.totalMs;
+        line["last_operation"] = summary.lastOperation;
+        print(line);
+    }
+
+    if (!verbose) {
+        qInstallMessageHandler(previous);
+    }
+    if (!ok) {
+        err << "基准测试失败: " << benchmark.lastError() << endl;
+        return DatabaseError;
+    }
+    if (!consistent) {
+        err << "并发测试中剩余激活次数与激活信息不一致" << endl;
+        return PartialFailure;
+    }
+    return Success;
+}
+
+void CommandLine::print(const QJsonObject &object)
+{
+    printTo(out, object);
+}
+
+void CommandLine::printTo(QTextStream &stream, const QJsonObject &object)
+{
+    stream << QString::fromUtf8(QJsonDocument(object).toJson(QJsonDocument::Compact)) << '\n';
+}
+
+int CommandLine::usage(const QString &message)
+{
+    if (!message.isEmpty()) {
+        err << message << endl;
+    }
+    err << "用法: KylinActivationManager --cli [--sqlite <文件>] <命令> [参数]" << endl
+        << "  import <目录或CSV文件...>   导入激活数据表，每个文件输出一行结果" << endl
+        << "  export [-o <文件>] [--format csv|ndjson] [--fields 列,...] [--filter 列=前缀]" << endl
+        << "                              导出序列号及激活信息（每个激活码一行）" << endl
+        << "  lookup <序列号...>          查询序列号及其激活信息" << endl
+        << "  stats                       数据量统计" << endl
+        << "  explain                     高频语句的执行计划" << endl
+        << "  bench [--sizes NxM,...] [--dir <目录>] [--seed N] [--queries N] [--stress-threads N] [--stress-ops N]" << endl
+        << "        [--stress-server]     用合成数据在本地 SQLite 上测各操作的耗时和内存；" << endl
+        << "                              --stress-server 时并发测试在配置的服务器上进行" << endl
+        << "数据库连接参数与界面相同，可用 KYLIN_ACTIVATION_SQLITE 等环境变量覆盖" << endl;
+    return message.isEmpty() ? Success : UsageError;
+}
@@ -0,0 +1,50 @@
+#ifndef COMMANDLINE_H
+#define COMMANDLINE_H
+
+#include <QStringList>
+#include <QJsonObject>
+#include <QTextStream>
+#include "activationstore.h"
+#include "benchmark.h"
+
+// 无界面的命令行模式：KylinActivationManager --cli <命令> [参数]
+// 直接在主线程使用 ActivationStore，不经过本地缓存和离线日志；
+// 结果按行输出 JSON（每行一个对象），错误信息输出到标准错误，便于脚本处理
+class CommandLine
+{
+public:
+    // 退出码
+    enum ExitCode {
+        Success = 0,
+        PartialFailure = 1,  // 部分文件导入失败、序列号不存在等
+        UsageError = 2,
+        DatabaseError = 3
+    };
+
+    CommandLine();
+
+    int run(const QStringList &arguments);
+
+private:
+    QTextStream out;
+    QTextStream err;
+    DatabaseConfig config;
+    QSqlDatabase db;
+    ActivationStore *store;
+
+    bool openStore();
+    void closeStore();
+
+    int importFiles(const QStringList &paths);
+    int exportData(const ExportOptions &options, const QString &outputPath);
+    int lookup(const QStringList &serialNumbers);
+    int stats();
+    int explain();
+    int bench(const Benchmark::Options &options, bool verbose);
+
+    void print(const QJsonObject &object);
+    void printTo(QTextStream &stream, const QJsonObject &object);
+    int usage(const QString &message = QString());
+};
+
+#endif // COMMANDLINE_H
@@ -0,0 +1,211 @@
+#include "csvparser.h"
+#include <QFile>
+#include <QDebug>
+#include <cstring>
+
+namespace {
+
+// 指向映射内存的一段字节，不持有数据
+struct Field {
+    const char *data = nullptr;
+    int size = 0;
+    bool escaped = false;  // 引号字段中含有 "" 转义
+
+    bool isEmpty() const { return size == 0; }
+
+    Field trimmed() const
+    {
+        Field result = *this;
+        while (result.size > 0 && (*result.data == ' ' || *result.data == '\t')) {
+            ++result.data;
+            --result.size;
+        }
+        while (result.size > 0) {
+            const char c = result.data[result.size - 1];
+            if (c != ' ' && c != '\t' && c != '\r') break;
+            --result.size;
+        }
+        return result;
+    }
+
+    bool contains(const char *needle) const
+    {
+        const int length = int(std::strlen(needle));
+        for (int i = 0; i + length <= size; ++i) {
+            if (std::memcmp(data + i, needle, size_t(length)) == 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // 读取开头的整数，"2/0" 得到 2
+    int toInt() const
+    {
+        const Field field = trimmed();
+        int i = 0;
+        bool negative = false;
+        if (i < field.size && (field.data[i] == '-' || field.data[i] == '+')) {
+            negative = field.data[i] == '-';
+            ++i;
+        }
+        int value = 0;
+        for (; i < field.size && field.data[i] >= '0' && field.data[i] <= '9'; ++i) {
+            value = value * 10 + (field.data[i] - '0');
+        }
+        return negative ? -value : value;
+    }
+
+    QString toString() const
+    {
+        QString text = QString::fromUtf8(data, size);
+        if (escaped) {
+            text.replace(QLatin1String("\"\""), QLatin1String("\""));
+        }
+        return text;
+    }
+};
+
+// 每行只关心前几个字段，多余的字段跳过
+const int MaxFields = 16;
+
+// 读取一行，pos 移到下一行开头，返回字段数（超过 MaxFields 的不计）
+// 引号内的逗号和换行属于字段内容
+int readRow(const char *&pos, const char *end, Field *fields)
+{
+    int count = 0;
+    for (;;) {
+        Field field;
+        if (pos < end && *pos == '"') {
+            const char *begin = ++pos;
+            while (pos < end) {
+                if (*pos == '"') {
+                    if (pos + 1 < end && pos[1] == '"') {
+                        field.escaped = true;
+                        pos += 2;
+                        continue;
+                    }
+                    break;
+                }
+                ++pos;
+            }
+            field.data = begin;
+            field.size = int(pos - begin);
+            if (pos < end) ++pos;  // 结束引号
+            // 结束引号到分隔符之间的内容忽略
+            while (pos < end && *pos != ',' && *pos != '\n' && *pos != '\r') ++pos;
+        } else {
+            const char *begin = pos;
+            while (pos < end && *pos != ',' && *pos != '\n' && *pos != '\r') ++pos;
+            field.data = begin;
+            field.size = int(pos - begin);
+        }
+
+        if (count < MaxFields) {
+            fields[count] = field;
+        }
+        ++count;
+
+        if (pos < end && *pos == ',') {
+            ++pos;
+            continue;
+        }
+
+        // 行尾：\n、\r\n 或单独的 \r
+        if (pos < end && *pos == '\r') ++pos;
+        if (pos < end && *pos == '\n') ++pos;
+        return qMin(count, MaxFields);
+    }
+}
+
+} // namespace
+
+CSVData CsvParser::parseFile(const QString &filePath)
+{
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qDebug() << "无法打开CSV文件:" << file.errorString();
+        return CSVData();
+    }
+
+    const qint64 size = file.size();
+    if (size == 0) {
+        return CSVData();
+    }
+
+    // 映射失败（如某些网络文件系统）时退回整体读取
+    CSVData data;
+    if (uchar *mapped = file.map(0, size)) {
+        data = parse(reinterpret_cast<const char *>(mapped), size);
+        file.unmap(mapped);
+    } else {
+        const QByteArray content = file.readAll();
+        data = parse(content.constData(), content.size());
+    }
+    return data;
+}
+
+CSVData CsvParser::parse(const char *data, qint64 size)
+{
+    CSVData result;
+    const char *pos = data;
+    const char *end = data + size;
+
+    // UTF-8 BOM
+    if (size >= 3 && std::memcmp(pos, "\xEF\xBB\xBF", 3) == 0) {
+        pos += 3;
+    }
+
+    // 依次经过：表头前 -> 主数据区（“激活数据表”之后）-> 激活码区（“注册码,激活码”之后）
+    // 进入激活码区后每行只取前两个字段，不再做关键字查找
+    enum Section { Preamble, MainData, Activations };
+    Section section = Preamble;
+
+    Field fields[MaxFields];
+    while (pos < end) {
+        const int count = readRow(pos, end, fields);
+        if (count == 1 && fields[0].trimmed().isEmpty()) {
+            continue;
+        }
+
+        if (section == Activations) {
+            if (count < 2) continue;
+            const Field regCode = fields[0].trimmed();
+            const Field actCode = fields[1].trimmed();
+            if (!regCode.isEmpty() && !actCode.isEmpty()) {
+                result.activationCodes.append(qMakePair(regCode.toString(), actCode.toString()));
+            }
+            continue;
+        }
+
+        if (count >= 2 && fields[0].contains("注册码") && fields[1].contains("激活码")) {
+            section = Activations;
+            continue;
+        }
+
+        if (section == Preamble) {
+            for (int i = 0; i < count; ++i) {
+                if (fields[i].contains("激活数据表")) {
+                    section = MainData;
+                    break;
+                }
+            }
+            continue;
+        }
+
+        // 主数据区，示例行:
+        // "服务序列号,63261116,授权总数,6,"
+        // "激活方式,扫码,可分配/可取消,2/0,"
+        for (int i = 0; i + 1 < count; ++i) {
+            if (fields[i].contains("服务序列号")) {
+                result.serialNumber = fields[i + 1].trimmed().toString();
+            } else if (fields[i].contains("授权总数")) {
+                result.totalActivations = fields[i + 1].toInt();
+            } else if (fields[i].contains("可分配/可取消")) {
+                result.remainingActivations = fields[i + 1].toInt();
+            }
+        }
+    }
+
+    return result;
+}
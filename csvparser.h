@@ -0,0 +1,20 @@
+#ifndef CSVPARSER_H
+#define CSVPARSER_H
+
+#include <QString>
+#include "serialrecord.h"
+
+// 激活数据表 CSV 解析
+// 文件整体映射到内存，直接在 UTF-8 字节上切分字段，
+// 只有最终保存到 CSVData 的字段才转换为 QString
+class CsvParser
+{
+public:
+    // 解析文件，打开失败或格式不正确时返回的 serialNumber 为空
+    static CSVData parseFile(const QString &filePath);
+
+    // 解析内存中的内容（可带 UTF-8 BOM）
+    static CSVData parse(const char *data, qint64 size);
+};
+
+#endif // CSVPARSER_H
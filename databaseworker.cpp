@@ -0,0 +1,75 @@
+#include "databaseworker.h"
+#include <QSqlDatabase>
+
+DatabaseWorker::DatabaseWorker(const QString &connectionName, QObject *parent)
+    : QObject(parent),
+      context(new QObject),
+      store(nullptr),
+      connectionName(connectionName),
+      pending(0)
+{
+    context->moveToThread(&thread);
+    thread.start();
+}
+
+DatabaseWorker::~DatabaseWorker()
+{
+    // 连接必须在创建它的线程中关闭和移除
+    QMetaObject::invokeMethod(context, [this]() {
+        if (store) {
+            store->logStatementStats();
+        }
+        delete store;
+        store = nullptr;
+        QSqlDatabase::database(connectionName, false).close();
+        QSqlDatabase::removeDatabase(connectionName);
+    }, Qt::BlockingQueuedConnection);
+
+    thread.quit();
+    thread.wait();
+    delete context;
+}
+
+void DatabaseWorker::open(const DatabaseConfig &config, QObject *receiver,
+                          std::function<void(const QString &)> done)
+{
+    // store 需要在工作线程中创建，因此 open 单独投递，不经过 submit
+    requestStarted();
+    QPointer<QObject> guard(receiver);
+    QMetaObject::invokeMethod(context, [this, config, guard, done]() {
+        QString error;
+        QSqlDatabase db = ActivationStore::openDatabase(config, connectionName, &error);
+        store = new ActivationStore(db);
+        store->setImportChunkSize(config.importChunkSize);
+        store->setBlobCompression(config.compressBlobs);
+        store->setLocalCache(config.localCache);
+        if (error.isEmpty() && !store->initSchema()) {
+            error = store->lastError();
+        }
+        QMetaObject::invokeMethod(this, [this, guard, done, error]() {
+            requestFinished();
+            if (guard) {
+                done(error);
+            }
+        }, Qt::QueuedConnection);
+    }, Qt::QueuedConnection);
+}
+
+int DatabaseWorker::pendingRequests() const
+{
+    return pending;
+}
+
+void DatabaseWorker::requestStarted()
+{
+    if (pending++ == 0) {
+        emit busyChanged(true);
+    }
+}
+
+void DatabaseWorker::requestFinished()
+{
+    if (--pending == 0) {
+        emit busyChanged(false);
+    }
+}
@@ -0,0 +1,62 @@
+#ifndef DATABASEWORKER_H
+#define DATABASEWORKER_H
+
+#include <QObject>
+#include <QThread>
+#include <QPointer>
+#include <functional>
+#include <utility>
+#include "activationstore.h"
+
+// 数据库工作线程
+// 持有独立的数据库连接，所有查询按提交顺序在该线程中执行，
+// 结果通过回调回到调用方所在线程，界面线程不会因查询或重连而卡住
+class DatabaseWorker : public QObject
+{
+    Q_OBJECT
+
+public:
+    // 每个工作线程使用各自的连接名，可同时打开服务器和本地缓存
+    explicit DatabaseWorker(const QString &connectionName = "kylin_worker", QObject *parent = nullptr);
+    ~DatabaseWorker();
+
+    // 在工作线程中打开连接并初始化表结构，完成后调用 done(错误信息)，成功时错误信息为空
+    void open(const DatabaseConfig &config, QObject *receiver, std::function<void(const QString &)> done);
+
+    // 提交一个请求：job 在工作线程中以 ActivationStore 执行，
+    // 其返回值在 receiver 所在线程传给 done；receiver 销毁后结果被丢弃
+    template <typename Job, typename Done>
+    void submit(QObject *receiver, Job job, Done done)
+    {
+        using Result = decltype(job(std::declval<ActivationStore &>()));
+
+        requestStarted();
+        QPointer<QObject> guard(receiver);
+        QMetaObject::invokeMethod(context, [this, guard, job, done]() mutable {
+            Result result = job(*store);
+            QMetaObject::invokeMethod(this, [this, guard, done, result]() mutable {
+                requestFinished();
+                if (guard) {
+                    done(result);
+                }
+            }, Qt::QueuedConnection);
+        }, Qt::QueuedConnection);
+    }
+
+    int pendingRequests() const;
+
+signals:
+    void busyChanged(bool busy);
+
+private:
+    QThread thread;
+    QObject *context;         // 属于工作线程，用于投递请求
+    ActivationStore *store;   // 只在工作线程中访问
+    QString connectionName;
+    int pending;
+
+    void requestStarted();
+    void requestFinished();
+};
+
+#endif // DATABASEWORKER_H
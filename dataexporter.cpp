@@ -0,0 +1,333 @@
+#include "dataexporter.h"
+#include "querymonitor.h"
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QIODevice>
+#include <QFileInfo>
+#include <QElapsedTimer>
+#include <QDebug>
+
+// 每块读取的序列号个数；每个序列号的激活信息条数受总激活次数限制，块的大小因此有上限
+static const int ChunkSerials = 2000;
+
+// 缓冲区达到该大小时写出
+static const int FlushBytes = 1 << 20;
+
+// 可导出的列，顺序与查询结果一致；前 7 列来自 serial_numbers，后 3 列来自 activation_info
+static const char *const Fields[] = {
+    "serial_number", "total_activations", "remaining_activations", "platform",
+    "verification_code", "bind_wechat", "bind_person",
+    "activation_code", "project_number", "chassis_number"
+};
+static const int FieldCount = sizeof(Fields) / sizeof(Fields[0]);
+static const int SerialFieldCount = 7;
+
+// LIKE 模式中的通配符以 ! 转义
+static QString escapeLike(const QString &text)
+{
+    QString escaped = text;
+    escaped.replace("!", "!!").replace("%", "!%").replace("_", "!_");
+    return escaped;
+}
+
+static void appendCsv(QByteArray &buffer, const QByteArray &value)
+{
+    // 含分隔符、引号或换行时加引号，内部引号写两次
+    bool quote = false;
+    for (char c : value) {
+        if (c == ',' || c == '"' || c == '\n' || c == '\r') {
+            quote = true;
+            break;
+        }
+    }
+    if (!quote) {
+        buffer += value;
+        return;
+    }
+    buffer += '"';
+    for (char c : value) {
+        if (c == '"') {
+            buffer += '"';
+        }
+        buffer += c;
+    }
+    buffer += '"';
+}
+
+static void appendJsonString(QByteArray &buffer, const QByteArray &value)
+{
+    // UTF-8 多字节字符原样输出，只转义控制字符、引号和反斜杠
+    static const char hex[] = "0123456789abcdef";
+    buffer += '"';
+    for (char c : value) {
+        const unsigned char byte = static_cast<unsigned char>(c);
+        if (c == '"' || c == '\\') {
+            buffer += '\\';
+            buffer += c;
+        } else if (c == '\n') {
+            buffer += "\\n";
+        } else if (c == '\r') {
+            buffer += "\\r";
+        } else if (c == '\t') {
+            buffer += "\\t";
+        } else if (byte < 0x20) {
+            buffer += "\\u00";
+            buffer += hex[byte >> 4];
+            buffer += hex[byte & 0xf];
+        } else {
+            buffer += c;
+        }
+    }
+    buffer += '"';
+}
+
+ExportOptions::Format ExportOptions::formatForFile(const QString &filePath)
+{
+    const QString suffix = QFileInfo(filePath).suffix().toLower();
+    if (suffix == "json" || suffix == "ndjson" || suffix == "jsonl") {
+        return Ndjson;
+    }
+    return Csv;
+}
+
+DataExporter::DataExporter(const QSqlDatabase &db)
+    : db(db)
+{
+}
+
+QStringList DataExporter::fieldNames()
+{
+    QStringList names;
+    for (int i = 0; i < FieldCount; ++i) {
+        names.append(Fields[i]);
+    }
+    return names;
+}
+
+bool DataExporter::write(const ExportOptions &options, QIODevice *device, const Progress &progress,
+                         ExportSummary &summary)
+{
+    error.clear();
+    summary = ExportSummary();
+
+    const QStringList names = fieldNames();
+    if (!options.filterColumn.isEmpty() && !names.contains(options.filterColumn)) {
+        return fail("不支持的筛选字段: " + options.filterColumn);
+    }
+    QVector<int> columns;
+    QVector<QByteArray> keys;  // NDJSON 的键，预先转成 UTF-8
+    for (const QString &field : options.fields.isEmpty() ? names : options.fields) {
+        const int index = names.indexOf(field);
+        if (index < 0) {
+            return fail("不支持的导出字段: " + field);
+        }
+        columns.append(index);
+        QByteArray key;
+        appendJsonString(key, field.toUtf8());
+        keys.append(key + ':');
+    }
+
+    qint64 total = 0;
+    if (!countSerials(options, total)) {
+        return false;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+
+    QByteArray buffer;
+    buffer.reserve(FlushBytes + 4096);
+    if (options.format == ExportOptions::Csv) {
+        // 带 BOM，Excel 打开时按 UTF-8 识别中文
+        buffer += "\xEF\xBB\xBF";
+        for (int i = 0; i < columns.size(); ++i) {
+            if (i > 0) {
+                buffer += ',';
+            }
+            buffer += Fields[columns.at(i)];
+        }
+        buffer += "\r\n";
+    }
+
+    // 筛选条件放在对应的表上：主行列在分块子查询中，激活信息列在外层
+    const bool serialFilter = !options.filterColumn.isEmpty()
+            && names.indexOf(options.filterColumn) < SerialFieldCount;
+    const bool activationFilter = !options.filterColumn.isEmpty() && !serialFilter;
+    const QString pattern = escapeLike(options.filterText) + "%";
+
+    QString after;
+    bool first = true;
+    qint64 scanned = 0;  // 已扫描的序列号，用于进度
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+    for (;;) {
+        QString inner = "SELECT serial_number, total_activations, remaining_activations, platform, "
+                        "verification_code, bind_wechat, bind_person FROM serial_numbers";
+        QStringList conditions;
+        if (!first) {
+            conditions << "serial_number > ?";
+        }
+        if (serialFilter) {
+            conditions << options.filterColumn + " LIKE ? ESCAPE '!'";
+        }
+        if (!conditions.isEmpty()) {
+            inner += " WHERE " + conditions.join(" AND ");
+        }
+        inner += " ORDER BY serial_number LIMIT ?";
+
+        query.prepare("SELECT s.serial_number, s.total_activations, s.remaining_activations, s.platform, "
+                      "s.verification_code, s.bind_wechat, s.bind_person, "
+                      "a.activation_code, a.project_number, a.chassis_number "
+                      "FROM (" + inner + ") s "
+                      "LEFT JOIN activation_info a ON a.serial_number = s.serial_number"
+                      + (activationFilter ? " WHERE a." + options.filterColumn + " LIKE ? ESCAPE '!'" : QString())
+                      + " ORDER BY s.serial_number, a.id");
+        if (!first) {
+            query.addBindValue(after);
+        }
+        if (serialFilter) {
+            query.addBindValue(pattern);
+        }
+        query.addBindValue(ChunkSerials);
+        if (activationFilter) {
+            query.addBindValue(pattern);
+        }
+        if (!QueryMonitor::exec(query)) {
+            return fail("导出失败: " + query.lastError().text());
+        }
+
+        // 按激活信息列筛选时，没有命中的序列号不会出现在结果中，因此块内序列号个数单独查询
+        int chunkSerials = 0;
+        QString last;
+        QVector<QByteArray> values(FieldCount);
+        while (query.next()) {
+            const QString serialNumber = query.value(0).toString();
+            if (serialNumber != last) {
+                last = serialNumber;
+                ++chunkSerials;
+            }
+            for (int column : columns) {
+                values[column] = query.value(column).toString().toUtf8();
+            }
+
+            if (options.format == ExportOptions::Csv) {
+                for (int i = 0; i < columns.size(); ++i) {
+                    if (i > 0) {
+                        buffer += ',';
+                    }
+                    appendCsv(buffer, values.at(columns.at(i)));
+                }
+                buffer += "\r\n";
+            } else {
+                buffer += '{';
+                for (int i = 0; i < columns.size(); ++i) {
+                    if (i > 0) {
+                        buffer += ',';
+                    }
+                    buffer += keys.at(i);
+                    const int column = columns.at(i);
+                    // 次数列输出为数字
+                    if (column == 1 || column == 2) {
+                        buffer += values.at(column).isEmpty() ? QByteArray("null") : values.at(column);
+                    } else {
+                        appendJsonString(buffer, values.at(column));
+                    }
+                }
+                buffer += "}\n";
+            }
+            ++summary.rows;
+
+            if (buffer.size() >= FlushBytes && !flush(device, buffer, summary)) {
+                return false;
+            }
+        }
+        query.finish();
+        summary.serials += chunkSerials;
+
+        bool more = false;
+        if (activationFilter) {
+            // 以块内最大的序列号为下一块起点，需要单独确认该块是否已满
+            QSqlQuery next(db);
+            next.prepare("SELECT serial_number FROM serial_numbers"
+                         + QString(first ? "" : " WHERE serial_number > ?")
+                         + " ORDER BY serial_number LIMIT 1 OFFSET ?");
+            if (!first) {
+                next.addBindValue(after);
+            }
+            next.addBindValue(ChunkSerials - 1);
+            if (!QueryMonitor::exec(next)) {
+                return fail("导出失败: " + next.lastError().text());
+            }
+            if (next.next()) {
+                after = next.value(0).toString();
+                more = true;
+            }
+            scanned = more ? scanned + ChunkSerials : total;
+        } else {
+            scanned += chunkSerials;
+            more = chunkSerials == ChunkSerials;
+            after = last;
+        }
+        first = false;
+
+        if (!flush(device, buffer, summary)) {
+            return false;
+        }
+        if (progress && !progress(scanned, total)) {
+            summary.cancelled = true;
+            break;
+        }
+        if (!more) {
+            break;
+        }
+    }
+
+    qDebug() << "导出序列号" << summary.serials << "个，" << summary.rows << "行，"
+             << summary.bytes << "字节，耗时" << timer.elapsed() << "ms"
+             << (summary.cancelled ? "（已取消）" : "");
+    return true;
+}
+
+QString DataExporter::lastError() const
+{
+    return error;
+}
+
+bool DataExporter::countSerials(const ExportOptions &options, qint64 &total)
+{
+    // 按激活信息列筛选时进度按扫描过的序列号计算
+    QSqlQuery query(db);
+    const bool serialFilter = !options.filterColumn.isEmpty()
+            && fieldNames().indexOf(options.filterColumn) < SerialFieldCount;
+    if (serialFilter) {
+        query.prepare("SELECT COUNT(*) FROM serial_numbers WHERE " + options.filterColumn + " LIKE ? ESCAPE '!'");
+        query.addBindValue(escapeLike(options.filterText) + "%");
+    } else {
+        query.prepare("SELECT COUNT(*) FROM serial_numbers");
+    }
+    if (!QueryMonitor::exec(query) || !query.next()) {
+        return fail("统计序列号失败: " + query.lastError().text());
+    }
+    total = query.value(0).toLongLong();
+    return true;
+}
+
+bool DataExporter::flush(QIODevice *device, QByteArray &buffer, ExportSummary &summary)
+{
+    if (buffer.isEmpty()) {
+        return true;
+    }
+    if (device->write(buffer) != buffer.size()) {
+        return fail("写入文件失败: " + device->errorString());
+    }
+    summary.bytes += buffer.size();
+    buffer.resize(0);  // 保留已分配的空间
+    return true;
+}
+
+bool DataExporter::fail(const QString &message)
+{
+    error = message;
+    qDebug() << message;
+    return false;
+}
@@ -0,0 +1,62 @@
+#ifndef DATAEXPORTER_H
+#define DATAEXPORTER_H
+
+#include <QSqlDatabase>
+#include <QStringList>
+#include <functional>
+
+class QIODevice;
+
+// 导出选项
+struct ExportOptions {
+    enum Format {
+        Csv,
+        Ndjson  // 每行一个 JSON 对象
+    };
+
+    Format format = Csv;
+    QStringList fields;   // 输出的列，为空表示全部（见 DataExporter::fieldNames）
+    QString filterColumn; // 按列前缀筛选，为空表示不筛选
+    QString filterText;
+
+    // 按文件扩展名选择格式：.json/.ndjson/.jsonl 为 NDJSON，其余为 CSV
+    static Format formatForFile(const QString &filePath);
+};
+
+// 导出结果
+struct ExportSummary {
+    qint64 serials = 0;
+    qint64 rows = 0;
+    qint64 bytes = 0;
+    bool cancelled = false;
+};
+
+// 序列号与激活信息的批量导出
+// 序列号按主键分块（每块固定个数），每块用一条 LEFT JOIN 语句和只进游标读取，
+// 逐行格式化到缓冲区，缓冲区满时写出；内存占用只与块大小有关，与表大小无关。
+// 每个激活码输出一行，没有激活信息的序列号输出一行、激活码列为空
+class DataExporter
+{
+public:
+    explicit DataExporter(const QSqlDatabase &db);
+
+    static QStringList fieldNames();
+
+    // 每写完一块调用 progress(已扫描序列号数, 序列号总数)，返回 false 时取消（已写出的内容由调用方丢弃）
+    typedef std::function<bool(qint64, qint64)> Progress;
+    bool write(const ExportOptions &options, QIODevice *device, const Progress &progress,
+               ExportSummary &summary);
+
+    QString lastError() const;
+
+private:
+    QSqlDatabase db;
+    QString error;
+
+    bool countSerials(const ExportOptions &options, qint64 &total);
+    QString filterCondition(const ExportOptions &options) const;
+    bool flush(QIODevice *device, QByteArray &buffer, ExportSummary &summary);
+    bool fail(const QString &message);
+};
+
+#endif // DATAEXPORTER_H
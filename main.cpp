@@ -1,10 +1,22 @@
 #include "mainwindow.h"
+#include "commandline.h"
 #include <QApplication>
+#include <QCoreApplication>
+#include <cstring>
 
 int main(int argc, char *argv[])
 {
+    // --cli 时不创建任何界面组件，可在没有图形环境的服务器上运行
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--cli") == 0) {
+            QCoreApplication app(argc, argv);
+            CommandLine commandLine;
+            return commandLine.run(app.arguments());
+        }
+    }
+
     QApplication a(argc, argv);
     MainWindow w;
     w.show();
     return a.exec();
-}
\ No newline at end of file
+}
@@ -1,42 +1,132 @@
 #include "mainwindow.h"
 #include "activationdialog.h"
-#include <QSqlQuery>
+#include "csvparser.h"
+#include "querymonitor.h"
 #include <QMessageBox>
 #include <QFileDialog>
 #include <QFile>
 #include <QMenu>
 #include <QInputDialog>
-#include <QStandardItem>
 #include <QHeaderView>
 #include <QTimer>
-#include <QSqlError>
 #include <QDebug>
 #include <QPluginLoader>
+#include <QElapsedTimer>
+#include <QStatusBar>
+#include <QDir>
+#include <QFileInfo>
+#include <QSet>
+#include <QFutureWatcher>
+#include <QtConcurrent>
+#include <QProgressDialog>
+#include <QDialogButtonBox>
+#include <QSaveFile>
+#include <QSharedPointer>
+#include <QAtomicInt>
+#include <QTableWidget>
+
+namespace {
+// 全量刷新缓存时从服务器取回的一页
+struct CachePage {
+    ChangeSet changes;
+    bool hasMore = false;
+};
+
+// 直接提交一项修改的结果
+struct OperationResult {
+    bool ok = false;
+    bool disconnected = false;  // 失败是因为连接断开
+    QString error;
+    SerialRecord updated;
+    ChangeSet fresh;            // 使用缓存时修改后服务器上的数据，先写入缓存再更新界面
+};
+
+// 提交一项离线修改的结果
+struct ReplayResult {
+    bool ok = false;
+    bool disconnected = false;  // 连接再次断开，保留在日志中
+    QString error;
+    QString conflict;           // 与其他工作站的修改冲突
+    SerialRecord updated;
+    ChangeSet fresh;
+};
+
+// 批量导入的结果
+struct ImportResult {
+    QStringList errors;         // 与导入计划一一对应，空字符串表示成功
+    ChangeSet fresh;
+};
+
+// 读取服务器上这些序列号修改后的数据；查不到的记为已删除
+// 读取失败时不影响修改本身，缓存由之后的增量同步补上
+void loadFresh(ActivationStore &store, const QStringList &serialNumbers, ChangeSet &fresh)
+{
+    if (!store.loadSerials(serialNumbers, fresh.serials)
+            || !store.loadActivations(serialNumbers, fresh.activations)) {
+        qDebug() << "读取修改后的数据失败:" << store.lastError();
+        fresh = ChangeSet();
+        return;
+    }
+    QSet<QString> removed;
+    for (const QString &serialNumber : serialNumbers) {
+        removed.insert(serialNumber);
+    }
+    for (const SerialRecord &record : fresh.serials) {
+        removed.remove(record.serialNumber);
+    }
+    fresh.removedSerials = removed.values();
+}
+
+// 受修改影响的序列号（修改序列号本身时包括新旧两个）
+QStringList affectedSerials(const PendingOperation &operation, const SerialRecord &updated)
+{
+    QStringList serialNumbers;
+    serialNumbers << operation.serialNumber;
+    if (!updated.serialNumber.isEmpty() && updated.serialNumber != operation.serialNumber) {
+        serialNumbers << updated.serialNumber;
+    }
+    return serialNumbers;
+}
+}
 
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent)
 {
     setupUI();
 
-    // 初始化数据库
-    if (!initDatabase()) {
-        QMessageBox::critical(this, "错误", "无法初始化数据库!");
-        QTimer::singleShot(0, this, &QMainWindow::close);
-        return;
-    }
-
-    // 加载数据
-    loadSerialNumbers();
-    loadActivationInfo();
-
     // 初始化搜索相关
     setupSearchDialog();
     currentSearchIndex = -1;
+
+    // 多工作站增量同步
+    changeCursor = 0;
+    syncing = false;
+    syncTimer = new QTimer(this);
+    syncTimer->setInterval(5000);
+    connect(syncTimer, &QTimer::timeout, this, &MainWindow::syncChanges);
+
+    // 本地缓存
+    cacheWorker = nullptr;
+    cacheReady = false;
+    serverOnline = false;
+    refreshingCache = false;
+    refreshFailed = false;
+    refreshCursor = 0;
+
+    // 离线操作日志
+    serverLoaded = false;
+    replaying = false;
+    reconnectDelay = 1000;
+    reconnectTimer = new QTimer(this);
+    reconnectTimer->setSingleShot(true);
+    connect(reconnectTimer, &QTimer::timeout, this, &MainWindow::tryReconnect);
+
+    // 初始化数据库，连接成功后加载数据
+    initDatabase();
 }
 
 MainWindow::~MainWindow()
 {
-    db.close();
 }
 
 void MainWindow::setupUI()
@@ -59,10 +149,51 @@ void MainWindow::setupUI()
         searchEdit->setFocus();
     });
 
+    // 维护：重新压缩已存储的 LICENSE/.kyinfo
+    recompressShortcut = new QShortcut(QKeySequence(Qt::CTRL + Qt::SHIFT + Qt::Key_C), this);
+    connect(recompressShortcut, &QShortcut::activated, this, &MainWindow::recompressBlobs);
+
+    // 维护：各条 SQL 的耗时分布
+    queryStatsShortcut = new QShortcut(QKeySequence(Qt::CTRL + Qt::SHIFT + Qt::Key_Q), this);
+    connect(queryStatsShortcut, &QShortcut::activated, this, &MainWindow::showQueryStats);
+
     // 添加导入按钮
-    QPushButton *importButton = new QPushButton("从CSV导入", this);
-    mainLayout->addWidget(importButton);
+    QHBoxLayout *importLayout = new QHBoxLayout();
+    importButton = new QPushButton("从CSV导入", this);
+    importDirButton = new QPushButton("从目录导入", this);
+    importLayout->addWidget(importButton);
+    importLayout->addWidget(importDirButton);
+    exportButton = new QPushButton("导出", this);
+    importLayout->addWidget(exportButton);
+    mainLayout->addLayout(importLayout);
     connect(importButton, &QPushButton::clicked, this, &MainWindow::importFromCSV);
+    connect(importDirButton, &QPushButton::clicked, this, &MainWindow::importFromDirectory);
+    connect(exportButton, &QPushButton::clicked, this, &MainWindow::exportData);
+
+    // 数据库访问进度
+    busyIndicator = new QProgressBar(this);
+    busyIndicator->setRange(0, 0);
+    busyIndicator->setMaximumWidth(150);
+    busyIndicator->setVisible(false);
+    statusBar()->addPermanentWidget(busyIndicator);
+
+    offlineLabel = new QLabel(this);
+    offlineLabel->setStyleSheet("color: red;");
+    offlineLabel->setVisible(false);
+    statusBar()->addPermanentWidget(offlineLabel);
+}
+
+void MainWindow::setBusy(bool busy)
+{
+    // 服务器和本地缓存各有一个工作线程，任一在忙都显示
+    busy = busy || dbWorker->pendingRequests() > 0
+            || (cacheWorker && cacheWorker->pendingRequests() > 0);
+    busyIndicator->setVisible(busy);
+    if (busy) {
+        statusBar()->showMessage("正在访问数据库...");
+    } else {
+        statusBar()->clearMessage();
+    }
 }
 
 void MainWindow::setupSerialForm()
@@ -146,9 +277,7 @@ void MainWindow::setupSerialTable()
     serialTableLayout = new QVBoxLayout(serialTableGroup);
 
     serialTableView = new QTreeView(serialTableGroup);
-    serialModel = new QStandardItemModel(this);
-    serialModel->setHorizontalHeaderLabels({"序列号", "总激活次数", "剩余次数", "硬件平台",
-                                          "验证码", "LICENSE", ".kyinfo", "绑定微信", "绑定人", "激活码", "项目号", "机箱序列号"});
+    serialModel = new SerialTreeModel(this);
     serialTableView->setModel(serialModel);
 //    serialTableView->horizontalHeader()->setSectionResizeMode(QHeaderView::Stretch);
     serialTableView->setContextMenuPolicy(Qt::CustomContextMenu);
@@ -159,168 +288,649 @@ void MainWindow::setupSerialTable()
 
     // 连接信号槽
     connect(serialTableView, &QTreeView::customContextMenuRequested, this, &MainWindow::showSerialContextMenu);
+
+    // 序列号在滚动到底部时按页加载；激活信息在展开时加载，被释放的子树同时折叠
+    connect(serialModel, &SerialTreeModel::serialsRequested, this, &MainWindow::loadMoreSerialNumbers);
+    connect(serialModel, &SerialTreeModel::activationsRequested, this, &MainWindow::loadActivations);
+    connect(serialModel, &SerialTreeModel::activationsReleased, serialTableView, &QTreeView::collapse);
+    connect(serialTableView, &QTreeView::expanded, this, [this](const QModelIndex &index) {
+        if (serialModel->isSerialIndex(index)) {
+            serialModel->touchActivations(index.row());
+        }
+    });
 }
 
-bool MainWindow::initDatabase()
-{
-    // MySQL连接
-    db = QSqlDatabase::addDatabase("QMYSQL");
-    db.setHostName("192.168.218.128");  // 改为你的服务器IP
-    db.setPort(3306);
-    db.setDatabaseName("kylin_activation");
-    db.setUserName("kylin_admin");
-    db.setPassword("StrongPassword123!");
-#if 0   //本地mysql数据库
-    db.setHostName("127.0.0.1");  // 改为你的服务器IP
-    db.setPort(3306);
-    db.setDatabaseName("mysql");
-    db.setUserName("root");
-    db.setPassword("qwer1234");
-#endif
-    // 设置连接选项
-    db.setConnectOptions("MYSQL_OPT_RECONNECT=1;MYSQL_OPT_CONNECT_TIMEOUT=3");
-    
-    if (!db.open()) {
-        QMessageBox::critical(nullptr, "数据库错误", 
-                            "无法连接数据库:\n" + db.lastError().text());
-        return false;
+void MainWindow::initDatabase()
+{
+    const DatabaseConfig config = DatabaseConfig::defaultConfig();
+    QueryMonitor::configure(config.slowQueryLog, config.slowQueryMs);
+
+    // 数据库连接和所有查询都在工作线程中进行
+    dbWorker = new DatabaseWorker("kylin_worker", this);
+    connect(dbWorker, &DatabaseWorker::busyChanged, this, &MainWindow::setBusy);
+
+    // 上次退出时未提交的离线修改在连接成功后继续提交
+    journal.reset(new OperationJournal(config.journalPath));
+    if (!journal->load()) {
+        QMessageBox::warning(this, "警告", journal->lastError());
     }
-    else{
-        qDebug()<< "成功连接数据库";
-    }
-    // 设置编码
-    QSqlQuery query;
-    if (!query.exec("SET NAMES 'utf8mb4'")) {
-        qDebug() << "设置编码失败:" << query.lastError();
-    }
-    
-    // 创建表（如果不存在）
-    if (!query.exec("CREATE TABLE IF NOT EXISTS serial_numbers ("
-                  "serial_number VARCHAR(50) PRIMARY KEY, "
-                  "total_activations INT, "
-                  "remaining_activations INT, "
-                  "platform VARCHAR(20), "
-                  "verification_code VARCHAR(100), "
-                  "license_file LONGBLOB, "
-                  "kyinfo_file LONGBLOB, "
-                  "bind_wechat VARCHAR(10), "
-                  "bind_person VARCHAR(50))")) {
-        qDebug() << "创建serial_numbers表失败:" << query.lastError();
-        return false;
+
+    if (config.cachePath.isEmpty()) {
+        openServer();
+        return;
     }
-    
-    if (!query.exec("CREATE TABLE IF NOT EXISTS activation_info ("
-                   "id INT AUTO_INCREMENT PRIMARY KEY, "
-                   "serial_number VARCHAR(50), "
-                   "activation_code VARCHAR(100), "
-                   "project_number VARCHAR(50), "
-                   "chassis_number VARCHAR(50), "
-                   "FOREIGN KEY(serial_number) REFERENCES serial_numbers(serial_number))")) {
-        qDebug() << "创建activation_info表失败:" << query.lastError();
-        return false;
+
+    // 先打开本地缓存：上次完整同步过时立即从缓存显示列表，再在后台连接服务器
+    QDir().mkpath(QFileInfo(config.cachePath).absolutePath());
+    cacheWorker = new DatabaseWorker("kylin_cache", this);
+    connect(cacheWorker, &DatabaseWorker::busyChanged, this, &MainWindow::setBusy);
+    cacheWorker->open(config.cacheConfig(), this, [](const QString &error) {
+        if (!error.isEmpty()) {
+            qDebug() << "无法打开本地缓存:" << error;
+        }
+    });
+
+    QElapsedTimer timer;
+    timer.start();
+    cacheWorker->submit(this, [](ActivationStore &store) {
+        StoreResult<qint64> result;
+        QString complete, cursor;
+        result.ok = store.readMeta("complete", complete) && store.readMeta("change_cursor", cursor)
+                && complete == "1";
+        result.value = cursor.toLongLong();
+        return result;
+    }, [this, timer](const StoreResult<qint64> &result) {
+        if (result.ok) {
+            cacheReady = true;
+            changeCursor = result.value;
+            changePending.clear();
+            loadSerialNumbers();
+            qDebug() << "从本地缓存启动，游标:" << changeCursor << "耗时" << timer.elapsed() << "ms";
+        }
+        openServer();
+    });
+}
+
+void MainWindow::openServer()
+{
+    dbWorker->open(DatabaseConfig::defaultConfig(), this, [this](const QString &error) {
+        if (!error.isEmpty()) {
+            // 不再退出：修改写入离线日志，后台定时重连
+            qDebug() << "无法连接服务器:" << error;
+            if (!cacheReady) {
+                QMessageBox::warning(this, "数据库错误",
+                                     "无法连接数据库:\n" + error + "\n\n修改将保存在本地，恢复连接后自动提交。");
+            }
+            goOffline();
+            return;
+        }
+        qDebug() << "成功连接数据库";
+        onServerConnected();
+    });
+}
+
+void MainWindow::onServerConnected()
+{
+    serverOnline = true;
+    reconnectDelay = 1000;
+    updateOfflineStatus();
+
+    if (!serverLoaded) {
+        serverLoaded = true;
+        if (cacheWorker) {
+            reconcileCache();
+        } else {
+            // 加载数据
+            loadSerialNumbers();
+
+            // 定时拉取其他工作站的修改
+            startSync();
+        }
+    } else {
+        startSync();
     }
-    db.setConnectOptions("MYSQL_OPT_SSL_ENABLE=1;"
-                   "MYSQL_OPT_SSL_VERIFY_SERVER_CERT=0;"
-                   "MYSQL_OPT_CONNECT_TIMEOUT=3");
-    return true;
+
+    replayJournal();
 }
-#if 0
-bool MainWindow::initDatabase()
+
+void MainWindow::goOffline()
 {
-    db = QSqlDatabase::addDatabase("QSQLITE");
-    db.setDatabaseName("kylin_activation.db");
+    // 之后的修改直接写入日志，不再等待连接超时
+    if (serverOnline) {
+        qDebug() << "与服务器的连接已断开";
+    }
+    serverOnline = false;
+    syncTimer->stop();
+    updateOfflineStatus();
 
-    if (!db.open()) {
-        return false;
+    if (!reconnectTimer->isActive()) {
+        reconnectTimer->start(reconnectDelay);
+        reconnectDelay = qMin(reconnectDelay * 2, 60000);
     }
+}
 
-    // 创建序列号表
-    QSqlQuery query;
-    if (!query.exec("CREATE TABLE IF NOT EXISTS serial_numbers ("
-                   "serial_number TEXT PRIMARY KEY, "
-                   "total_activations INTEGER, "
-                   "remaining_activations INTEGER, "
-                   "platform TEXT, "
-                   "verification_code TEXT, "
-                   "license_file BLOB, "
-                   "kyinfo_file BLOB, "
-                   "bind_wechat TEXT, "
-                   "bind_person TEXT)")) {
-        return false;
+void MainWindow::tryReconnect()
+{
+    dbWorker->submit(this, [](ActivationStore &store) {
+        StoreResult<bool> result;
+        result.ok = store.checkConnection();
+        result.error = store.lastError();
+        return result;
+    }, [this](const StoreResult<bool> &result) {
+        if (!result.ok) {
+            qDebug() << "重连失败，" << reconnectDelay / 1000 << "秒后重试:" << result.error;
+            goOffline();
+            return;
+        }
+        qDebug() << "已重新连接服务器";
+        onServerConnected();
+    });
+}
+
+void MainWindow::checkServer()
+{
+    // 请求失败后确认是否是连接断开
+    dbWorker->submit(this, [](ActivationStore &store) {
+        return store.checkConnection();
+    }, [this](bool connected) {
+        if (!connected) {
+            goOffline();
+        }
+    });
+}
+
+void MainWindow::updateOfflineStatus()
+{
+    QStringList parts;
+    if (!serverOnline) {
+        parts << (cacheReady ? "无法连接服务器，当前显示本地缓存" : "无法连接服务器");
+    }
+    if (journal && !journal->isEmpty()) {
+        parts << QString("%1 项修改等待提交").arg(journal->size());
     }
+    offlineLabel->setText(parts.join("，"));
+    offlineLabel->setVisible(!parts.isEmpty());
+}
 
-    // 创建激活信息表
-    if (!query.exec("CREATE TABLE IF NOT EXISTS activation_info ("
-                   "id INTEGER PRIMARY KEY AUTOINCREMENT, "
-                   "serial_number TEXT, "
-                   "activation_code TEXT, "
-                   "project_number TEXT, "
-                   "chassis_number TEXT, "
-                   "FOREIGN KEY(serial_number) REFERENCES serial_numbers(serial_number))")) {
-        return false;
+void MainWindow::submitOperation(const PendingOperation &operation,
+                                 std::function<void(const QString &, const SerialRecord &)> done)
+{
+    // 离线或还有未提交的修改时先写入日志，保证所有修改按顺序到达服务器
+    if (!serverOnline || !journal->isEmpty()) {
+        QString error;
+        queueOperation(operation, error);
+        done(error, SerialRecord());
+        return;
     }
 
+    // 读取走本地缓存时，修改后的数据要先写入缓存，否则随后展开、搜索或导出会读到旧数据；
+    // 缓存连接按提交顺序执行，之后提交的读取一定在写入之后
+    const bool mirror = cacheReady;
+    dbWorker->submit(this, [operation, mirror](ActivationStore &store) {
+        OperationResult result;
+        result.ok = OperationJournal::apply(store, operation, result.error, result.updated);
+        result.disconnected = !result.ok && !store.checkConnection();
+        if (result.ok && mirror) {
+            loadFresh(store, affectedSerials(operation, result.updated), result.fresh);
+        }
+        return result;
+    }, [this, operation, done, mirror](const OperationResult &result) {
+        if (!result.disconnected) {
+            if (result.ok && mirror) {
+                mirrorToCache(result.fresh, false);
+            }
+            done(result.ok ? QString() : result.error, result.updated);
+            return;
+        }
+        goOffline();
+        QString error;
+        queueOperation(operation, error);
+        done(error, SerialRecord());
+    });
+}
+
+bool MainWindow::queueOperation(const PendingOperation &operation, QString &error)
+{
+    if (!journal->append(operation)) {
+        error = "无法保存离线修改: " + journal->lastError();
+        return false;
+    }
+    qDebug() << "已写入操作日志:" << operation.description();
+    statusBar()->showMessage("修改已保存在本地，恢复连接后自动提交", 5000);
+    updateOfflineStatus();
+    if (serverOnline) {
+        replayJournal();
+    }
     return true;
 }
-#endif
 
-void MainWindow::loadSerialNumbers()
+void MainWindow::replayJournal()
 {
-    serialModel->removeRows(0, serialModel->rowCount());
-
-    QSqlQuery query("SELECT * FROM serial_numbers");
-    while (query.next()) {
-        QList<QStandardItem*> items;
-        items << new QStandardItem(query.value("serial_number").toString());
-        items << new QStandardItem(query.value("total_activations").toString());
-        items << new QStandardItem(query.value("remaining_activations").toString());
-        items << new QStandardItem(query.value("platform").toString());
-        items << new QStandardItem(query.value("verification_code").toString());
-        items << new QStandardItem(query.value("license_file").isNull() ? "无" : "有");
-        items << new QStandardItem(query.value("kyinfo_file").isNull() ? "无" : "有");
-        items << new QStandardItem(query.value("bind_wechat").toString());
-        items << new QStandardItem(query.value("bind_person").toString());
-
-        serialModel->appendRow(items);
-    }
-}
-
-void MainWindow::loadActivationInfo()
-{
-     // 遍历所有激活信息，添加到对应主行下作为子项
-    QSqlQuery query("SELECT * FROM activation_info");
-    while (query.next()) {
-        QString serialNumber = query.value("serial_number").toString();
-        QString activationCode = query.value("activation_code").toString();
-        QString projectNumber = query.value("project_number").toString();
-        QString chassisNumber = query.value("chassis_number").toString();
-
-        // 查找对应的主行（顶层项）
-        QStandardItem *parentItem = nullptr;
-        for (int row = 0; row < serialModel->rowCount(); ++row) {
-            QStandardItem *item = serialModel->item(row, 0);  // 主行的序列号列
-            if (item && item->text() == serialNumber) {
-                parentItem = item;  // 找到主行的第一项（作为父项）
-                break;
+    if (replaying || !serverOnline) {
+        return;
+    }
+    if (journal->isEmpty()) {
+        if (!replayConflicts.isEmpty()) {
+            QMessageBox::warning(this, "离线修改冲突",
+                                 "以下离线修改与其他工作站的修改冲突，未提交：\n\n" + replayConflicts.join("\n"));
+            replayConflicts.clear();
+        }
+        return;
+    }
+    replaying = true;
+
+    // 每次提交一项，成功后才从日志中删除；连接再次断开时保留在日志中等待重连
+    const PendingOperation operation = journal->first();
+    const bool mirror = cacheReady;
+    dbWorker->submit(this, [operation, mirror](ActivationStore &store) {
+        ReplayResult result;
+        if (!OperationJournal::checkConflict(store, operation, result.conflict)) {
+            result.error = store.lastError();
+        } else if (result.conflict.isEmpty()) {
+            result.ok = OperationJournal::apply(store, operation, result.error, result.updated);
+        }
+        if (!result.ok && result.conflict.isEmpty()) {
+            result.disconnected = !store.checkConnection();
+        }
+        if (result.ok && mirror) {
+            loadFresh(store, affectedSerials(operation, result.updated), result.fresh);
+        }
+        return result;
+    }, [this, operation, mirror](const ReplayResult &result) {
+        replaying = false;
+        if (result.disconnected) {
+            goOffline();
+            return;
+        }
+        if (!result.ok) {
+            // 冲突或服务器拒绝：不再重试，界面以服务器上的数据为准
+            const QString reason = result.conflict.isEmpty() ? result.error : result.conflict;
+            qDebug() << "离线修改未能提交:" << operation.description() << reason;
+            replayConflicts.append(operation.description() + "：" + reason);
+            refreshSerial(operation.serialNumber);
+        } else {
+            qDebug() << "已提交离线修改:" << operation.description();
+            if (mirror) {
+                mirrorToCache(result.fresh, false);
             }
+            if (!result.updated.serialNumber.isEmpty()) {
+                serialModel->upsertSerial(result.updated);
+            }
+        }
+        if (!journal->removeFirst()) {
+            qDebug() << journal->lastError();
+        }
+        updateOfflineStatus();
+        replayJournal();
+    });
+}
+
+void MainWindow::updateSerialRow(const QString &serialNumber, const SerialRecord &updated, int remainingDelta)
+{
+    // 用服务器返回的主行更新界面；写入离线日志时在本地推算，
+    // 版本号同样加 1，之后对这一行的离线修改按此版本提交
+    if (!updated.serialNumber.isEmpty()) {
+        serialModel->upsertSerial(updated);
+        return;
+    }
+    int row = serialModel->findSerial(serialNumber);
+    if (row < 0) {
+        return;
+    }
+    SerialRecord record = serialModel->serial(row);
+    record.remainingActivations += remainingDelta;
+    ++record.version;
+    serialModel->upsertSerial(record);
+}
+
+void MainWindow::refreshSerial(const QString &serialNumber)
+{
+    dbWorker->submit(this, [serialNumber](ActivationStore &store) {
+        StoreResult<ChangeSet> result;
+        result.ok = store.loadSerials(QStringList() << serialNumber, result.value.serials)
+                && store.loadActivations(QStringList() << serialNumber, result.value.activations);
+        result.error = store.lastError();
+        return result;
+    }, [this, serialNumber](const StoreResult<ChangeSet> &result) {
+        if (!result.ok) {
+            return;
+        }
+        if (result.value.serials.isEmpty()) {
+            serialModel->removeSerial(serialModel->findSerial(serialNumber));
+            return;
+        }
+        const SerialRecord &record = result.value.serials.first();
+        int row = serialModel->upsertSerial(record);
+        serialModel->replaceActivations(row, result.value.activations.value(serialNumber));
+    });
+}
+
+DatabaseWorker *MainWindow::readWorker() const
+{
+    return cacheReady ? cacheWorker : dbWorker;
+}
+
+void MainWindow::reconcileCache()
+{
+    // 第一次使用缓存：列表先从服务器加载，同时在后台建立缓存
+    if (!cacheReady) {
+        loadSerialNumbers();
+        refreshCache(false);
+        return;
+    }
+
+    // 缓存之后的变更日志还在时按日志增量同步，否则全量刷新
+    const qint64 cursor = changeCursor;
+    dbWorker->submit(this, [cursor](ActivationStore &store) {
+        StoreResult<bool> result;
+        result.ok = store.changeLogCovers(cursor, result.value);
+        result.error = store.lastError();
+        return result;
+    }, [this](const StoreResult<bool> &result) {
+        if (result.ok && result.value) {
+            startSync();
+            syncChanges();
+            return;
         }
+        qDebug() << "本地缓存已过期，重新同步";
+        refreshCache(true);
+    });
+}
+
+void MainWindow::refreshCache(bool redraw)
+{
+    if (refreshingCache) {
+        return;
+    }
+    refreshingCache = true;
+    refreshFailed = false;
+    syncTimer->stop();
+    refreshSeen.clear();
+
+    // 先记下变更日志位置，刷新期间的修改在之后的同步中补上
+    dbWorker->submit(this, [](ActivationStore &store) {
+        qint64 cursor = 0;
+        store.currentChangeCursor(cursor);
+        return cursor;
+    }, [this](qint64 cursor) {
+        refreshCursor = cursor;
+    });
+    refreshCachePage(QString(), redraw);
+}
 
-        if (parentItem) {
-            QList<QStandardItem*> childItems;
-            // 创建子项（12列，比主模型多激活码、项目号、机箱号）
-            for (int i = 0; i < 9; ++i) {
-                childItems << new QStandardItem("");  // 填充剩余列
+void MainWindow::refreshCachePage(const QString &afterSerialNumber, bool redraw)
+{
+    static const int PageSize = 1000;
+
+    dbWorker->submit(this, [afterSerialNumber](ActivationStore &store) {
+        StoreResult<CachePage> result;
+        SerialPage page;
+        QStringList serialNumbers;
+        result.ok = store.loadSerialPage(afterSerialNumber, PageSize, page);
+        if (result.ok) {
+            for (const SerialRecord &record : page.serials) {
+                serialNumbers.append(record.serialNumber);
             }
-            childItems << new QStandardItem(activationCode);    // 列0
-            childItems << new QStandardItem(projectNumber);     // 列1
-            childItems << new QStandardItem(chassisNumber);     // 列2
+            result.ok = store.loadActivations(serialNumbers, result.value.changes.activations);
+        }
+        result.value.changes.serials = page.serials;
+        result.value.hasMore = page.hasMore;
+        result.error = store.lastError();
+        return result;
+    }, [this, redraw](const StoreResult<CachePage> &result) {
+        if (!result.ok) {
+            // 稍后重试，期间缓存保持原状
+            qDebug() << "刷新本地缓存失败:" << result.error;
+            refreshingCache = false;
+            QTimer::singleShot(30000, this, [this, redraw]() {
+                refreshCache(redraw);
+            });
+            return;
+        }
+
+        const ChangeSet &changes = result.value.changes;
+        for (const SerialRecord &record : changes.serials) {
+            refreshSeen.insert(record.serialNumber);
+        }
+        cacheWorker->submit(this, [changes](ActivationStore &store) {
+            StoreResult<bool> mirrored;
+            mirrored.ok = store.mirrorChanges(changes);
+            mirrored.error = store.lastError();
+            return mirrored;
+        }, [this](const StoreResult<bool> &mirrored) {
+            if (!mirrored.ok) {
+                qDebug() << "写入本地缓存失败:" << mirrored.error;
+                refreshFailed = true;
+            }
+        });
+
+        if (result.value.hasMore && !changes.serials.isEmpty()) {
+            refreshCachePage(changes.serials.last().serialNumber, redraw);
+        } else {
+            finishCacheRefresh(redraw);
+        }
+    });
+}
+
+void MainWindow::finishCacheRefresh(bool redraw)
+{
+    // 缓存连接按顺序执行，这个空请求返回时各页的写入结果都已回到界面线程
+    cacheWorker->submit(this, [](ActivationStore &) {
+        return true;
+    }, [this, redraw](bool) {
+        if (!refreshFailed) {
+            saveCacheRefresh(redraw);
+            return;
+        }
+
+        // 有一页没有写入缓存：不标记为完整，改从服务器读取，稍后重新全量刷新
+        qDebug() << "本地缓存刷新不完整，稍后重试";
+        refreshingCache = false;
+        refreshSeen.clear();
+        cacheReady = false;
+        cacheWorker->submit(this, [](ActivationStore &store) {
+            return store.writeMeta("complete", "0");
+        }, [](bool) {});
+        QTimer::singleShot(30000, this, [this, redraw]() {
+            refreshCache(redraw);
+        });
+    });
+}
+
+void MainWindow::saveCacheRefresh(bool redraw)
+{
+    const QSet<QString> seen = refreshSeen;
+    const qint64 cursor = refreshCursor;
+    const int count = seen.size();
+    refreshSeen.clear();
+    cacheWorker->submit(this, [seen, cursor](ActivationStore &store) {
+        StoreResult<bool> result;
+        result.ok = store.retainSerials(seen)
+                && store.writeMeta("change_cursor", QString::number(cursor))
+                && store.writeMeta("complete", "1");
+        result.error = store.lastError();
+        return result;
+    }, [this, cursor, redraw, count](const StoreResult<bool> &result) {
+        refreshingCache = false;
+        if (!result.ok) {
+            qDebug() << "保存本地缓存失败:" << result.error;
+            startSync();
+            return;
+        }
+        qDebug() << "本地缓存已同步" << count << "个序列号，游标:" << cursor;
+
+        // 从刷新开始的位置重放变更日志，模型和缓存中已有的修改重放后不变
+        cacheReady = true;
+        changeCursor = cursor;
+        changePending.clear();
+        if (redraw) {
+            loadSerialNumbers();
+        }
+        startSync();
+    });
+}
+
+void MainWindow::startSync()
+{
+    // 显示服务器搜索结果或全量刷新缓存期间不同步，结束时再由它们恢复
+    if (serverResultsShown || refreshingCache) {
+        return;
+    }
+    syncTimer->start();
+}
+
+void MainWindow::syncChanges()
+{
+    if (syncing || !serverOnline || serverResultsShown) {
+        return;
+    }
+    syncing = true;
+
+    // 使用缓存时本工作站自己的修改也要取回，写入缓存
+    const qint64 cursor = changeCursor;
+    const QSet<qint64> pending = changePending;
+    const bool mirror = cacheReady;
+    dbWorker->submit(this, [cursor, pending, mirror](ActivationStore &store) {
+        StoreResult<ChangeSet> result;
+        result.ok = store.fetchChanges(cursor, pending, result.value, mirror);
+        result.error = store.lastError();
+        return result;
+    }, [this, cursor, mirror](const StoreResult<ChangeSet> &result) {
+        syncing = false;
+        if (!result.ok) {
+            qDebug() << "同步失败:" << result.error;
+            checkServer();
+            return;
+        }
+        const ChangeSet &changes = result.value;
+        applyChanges(changes);
+        if (mirror && (changes.cursor != cursor || !changes.serials.isEmpty() || !changes.removedSerials.isEmpty())) {
+            mirrorToCache(changes);
+        }
+    });
+}
 
-            // 添加到主行下
-            parentItem->appendRow(childItems);
+void MainWindow::mirrorToCache(const ChangeSet &changes, bool saveCursor)
+{
+    cacheWorker->submit(this, [changes, saveCursor](ActivationStore &store) {
+        StoreResult<bool> result;
+        result.ok = store.mirrorChanges(changes)
+                && (!saveCursor || store.writeMeta("change_cursor", QString::number(changes.cursor)));
+        result.error = store.lastError();
+        if (!result.ok) {
+            // 缓存与游标不一致，下次启动时全量刷新
+            store.writeMeta("complete", "0");
+        }
+        return result;
+    }, [](const StoreResult<bool> &result) {
+        if (!result.ok) {
+            qDebug() << "写入本地缓存失败:" << result.error;
         }
+    });
+}
+
+void MainWindow::applyChanges(const ChangeSet &changes)
+{
+    changeCursor = changes.cursor;
+    changePending = changes.pendingIds;
+
+    // 只修补变化的序列号及其子行
+    for (const QString &serialNumber : changes.removedSerials) {
+        serialModel->removeSerial(serialModel->findSerial(serialNumber));
+    }
+    for (const SerialRecord &record : changes.serials) {
+        int row = serialModel->upsertSerial(record);
+        serialModel->replaceActivations(row, changes.activations.value(record.serialNumber));
+    }
+
+    int count = changes.removedSerials.size() + changes.serials.size();
+    if (count > 0) {
+        qDebug() << "已同步" << count << "个序列号的修改，游标:" << changeCursor;
+        statusBar()->showMessage(QString("已同步其他工作站的 %1 处修改").arg(count), 3000);
     }
 }
 
+void MainWindow::loadSerialNumbers()
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    // 先记下变更日志位置，加载期间其他工作站的修改会在下次同步时补上；
+    // 从本地缓存加载时游标是缓存的同步位置
+    if (readWorker() == dbWorker) {
+        dbWorker->submit(this, [](ActivationStore &store) {
+            qint64 cursor = 0;
+            store.currentChangeCursor(cursor);
+            return cursor;
+        }, [this](qint64 cursor) {
+            changeCursor = cursor;
+            changePending.clear();
+        });
+    }
+
+    // 先取一屏，其余在滚动到底部时按页加载
+    static const int FirstPageSize = 100;
+    readWorker()->submit(this, [](ActivationStore &store) {
+        StoreResult<SerialPage> result;
+        result.ok = store.loadSerialPage(QString(), FirstPageSize, result.value);
+        result.error = store.lastError();
+        return result;
+    }, [this, timer](const StoreResult<SerialPage> &result) {
+        if (!result.ok) {
+            serialModel->clear();
+            QMessageBox::critical(this, "错误", result.error);
+            return;
+        }
+        serialModel->setFirstSerialPage(result.value.serials, result.value.hasMore);
+        qDebug() << "加载首页序列号" << result.value.serials.size() << "条，耗时" << timer.elapsed() << "ms";
+    });
+}
+
+void MainWindow::loadMoreSerialNumbers(const QString &afterSerialNumber)
+{
+    static const int PageSize = 500;
+    QElapsedTimer timer;
+    timer.start();
+
+    readWorker()->submit(this, [afterSerialNumber](ActivationStore &store) {
+        StoreResult<SerialPage> result;
+        result.ok = store.loadSerialPage(afterSerialNumber, PageSize, result.value);
+        result.error = store.lastError();
+        return result;
+    }, [this, timer](const StoreResult<SerialPage> &result) {
+        if (!result.ok) {
+            serialModel->cancelSerialFetch();
+            QMessageBox::critical(this, "错误", result.error);
+            return;
+        }
+        serialModel->appendSerialPage(result.value.serials, result.value.hasMore);
+        qDebug() << "加载序列号" << result.value.serials.size() << "条，共" << serialModel->rowCount()
+                 << "条，耗时" << timer.elapsed() << "ms";
+    });
+}
+
+void MainWindow::loadActivations(const QString &serialNumber)
+{
+    // 主行首次展开时由模型请求
+    readWorker()->submit(this, [serialNumber](ActivationStore &store) {
+        StoreResult<QVector<ActivationRecord>> result;
+        result.ok = store.loadActivations(serialNumber, result.value);
+        result.error = store.lastError();
+        return result;
+    }, [this, serialNumber](const StoreResult<QVector<ActivationRecord>> &result) {
+        int row = serialModel->findSerial(serialNumber);
+        if (row < 0) {
+            return;
+        }
+        if (!result.ok) {
+            serialModel->cancelActivationFetch(row);
+            QMessageBox::critical(this, "错误", result.error);
+            return;
+        }
+        serialModel->setLoadedActivations(row, result.value);
+    });
+}
+
 void MainWindow::setupSearchDialog()
 {
     searchDialog = new QDialog(this);
@@ -349,12 +959,58 @@ void MainWindow::setupSearchDialog()
     buttonLayout->addWidget(searchNextButton);
     // buttonLayout->addWidget(closeButton);
 
+    // 服务器端搜索选项
+    QHBoxLayout *serverLayout = new QHBoxLayout();
+    serverSearchCheck = new QCheckBox("服务器搜索", searchDialog);
+    serverSearchCheck->setToolTip("在数据库中搜索，只加载命中的序列号");
+    prefixSearchCheck = new QCheckBox("仅前缀", searchDialog);
+    prefixSearchCheck->setEnabled(false);
+    loadMoreButton = new QPushButton("加载更多", searchDialog);
+    loadMoreButton->setVisible(false);
+    serverLayout->addWidget(serverSearchCheck);
+    serverLayout->addWidget(prefixSearchCheck);
+    serverLayout->addStretch();
+    serverLayout->addWidget(loadMoreButton);
+    serverResultsShown = false;
+    serverSearchOffset = 0;
+    serverSearchSerial = 0;
+
     layout->addLayout(fieldLayout);
     layout->addWidget(searchEdit);
+    layout->addLayout(serverLayout);
     layout->addLayout(buttonLayout);
 
-    // 添加文本变化实时搜索
-    connect(searchEdit, &QLineEdit::textChanged, this, &MainWindow::performSearch);
+    // 输入停顿 150ms 后再搜索，连续输入时不逐键查询
+    searchTimer = new QTimer(this);
+    searchTimer->setSingleShot(true);
+    searchTimer->setInterval(150);
+    lastSearchColumn = -1;
+    connect(searchTimer, &QTimer::timeout, this, &MainWindow::performSearch);
+    connect(searchEdit, &QLineEdit::textChanged, searchTimer, static_cast<void (QTimer::*)()>(&QTimer::start));
+    connect(searchFieldCombo, static_cast<void (QComboBox::*)(int)>(&QComboBox::currentIndexChanged),
+            this, &MainWindow::performSearch);
+    connect(prefixSearchCheck, &QCheckBox::toggled, this, &MainWindow::performSearch);
+    connect(serverSearchCheck, &QCheckBox::toggled, this, [this](bool checked) {
+        prefixSearchCheck->setEnabled(checked);
+        if (checked) {
+            performSearch();
+        } else {
+            leaveServerSearch();
+        }
+    });
+    connect(loadMoreButton, &QPushButton::clicked, this, [this]() {
+        performServerSearch(true);
+    });
+
+    // 数据变化后上一次的结果不能再用于缩小范围
+    connect(serialModel, &QAbstractItemModel::rowsInserted, this, &MainWindow::invalidateSearch);
+    connect(serialModel, &QAbstractItemModel::modelReset, this, &MainWindow::invalidateSearch);
+    connect(serialModel, &QAbstractItemModel::dataChanged, this,
+            [this](const QModelIndex &, const QModelIndex &, const QVector<int> &roles) {
+        if (roles.isEmpty() || roles.contains(Qt::DisplayRole)) {
+            invalidateSearch();
+        }
+    });
     // 连接信号槽
     connect(searchEdit, &QLineEdit::returnPressed, this, &MainWindow::performSearch);
     connect(searchNextButton, &QPushButton::clicked, this, &MainWindow::findNext);
@@ -364,20 +1020,32 @@ void MainWindow::setupSearchDialog()
     connect(searchDialog, &QDialog::finished, this, [this](int result) {
         Q_UNUSED(result);
         clearSearchHighlights();  // 对话框关闭时清除高亮
+        serverSearchCheck->setChecked(false);  // 恢复完整列表
     });
 }
 
 void MainWindow::performSearch()
 {
+    searchTimer->stop();
     QString searchText = searchEdit->text().trimmed();
 
-    // 即使搜索内容为空也清除之前的高亮
-    clearSearchHighlights();
-
     if (searchText.isEmpty()) {
+        clearSearchHighlights();
         return;
     }
 
+    int column = currentSearchColumn();
+    if (column == -1) return;
+
+    if (serverSearchCheck->isChecked()) {
+        performServerSearch(false);
+    } else {
+        searchModel(column, searchText);
+    }
+}
+
+int MainWindow::currentSearchColumn() const
+{
     QString field = searchFieldCombo->currentText();
     int column = -1;
 
@@ -386,39 +1054,208 @@ void MainWindow::performSearch()
     else if (field == "项目号") column = 10;
     else if (field == "机箱序列号") column = 11;
 
-    if (column == -1) return;
+    return column;
+}
+
+// 搜索字段对应的数据库列
+static QString searchColumnName(int column)
+{
+    switch (column) {
+    case SerialTreeModel::SerialNumberColumn: return "serial_number";
+    case SerialTreeModel::ActivationCodeColumn: return "activation_code";
+    case SerialTreeModel::ProjectNumberColumn: return "project_number";
+    case SerialTreeModel::ChassisNumberColumn: return "chassis_number";
+    default: return QString();
+    }
+}
+
+void MainWindow::searchModel(int column, const QString &searchText, bool fetchUnloaded)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    const bool refine = column == lastSearchColumn && !lastSearchText.isEmpty()
+            && searchText.contains(lastSearchText, Qt::CaseInsensitive);
+
+    // 主行分页加载、子行按需加载，未加载的部分不在本地索引中：先从数据库取回命中的序列号及其子行
+    const bool incomplete = serialModel->hasMoreSerials()
+            || (column != SerialTreeModel::SerialNumberColumn && serialModel->hasUnloadedActivations());
+    if (!refine && fetchUnloaded && incomplete) {
+        fetchSearchMatches(column, searchText);
+        return;
+    }
+
+    if (refine) {
+        // 查询串只是变长了：结果必然是上一次结果的子集，直接在其中筛选
+        QList<QPersistentModelIndex> refined;
+        for (const QPersistentModelIndex &result : searchResults) {
+            if (result.isValid() && result.data().toString().contains(searchText, Qt::CaseInsensitive)) {
+                refined.append(result);
+            }
+        }
+        searchResults = refined;
+    } else {
+        // 由模型的三字符索引得到候选行，不再遍历全部主行和子行
+        searchResults.clear();
+        for (const QModelIndex &match : serialModel->search(column, searchText)) {
+            searchResults.append(match);
+        }
+    }
+    lastSearchText = searchText;
+    lastSearchColumn = column;
+
+    // 序列号完全匹配的排在最前
+    if (column == SerialTreeModel::SerialNumberColumn) {
+        int exactRow = serialModel->findSerial(searchText);
+        for (int i = 1; i < searchResults.size() && exactRow >= 0; ++i) {
+            if (searchResults.at(i).row() == exactRow) {
+                searchResults.move(i, 0);
+                break;
+            }
+        }
+    }
+
+    QModelIndexList matches;
+    matches.reserve(searchResults.size());
+    for (const QPersistentModelIndex &result : searchResults) {
+        matches.append(result);
+    }
+    serialModel->setSearchMatches(column, matches);
+    qDebug() << "搜索" << searchText << "命中" << searchResults.size() << "项，耗时" << timer.nsecsElapsed() / 1000 << "us";
 
-    // 重新搜索前清空结果
-    searchResults.clear();
     currentSearchIndex = -1;
+    if (!searchResults.isEmpty()) {
+        currentSearchIndex = 0;
+        highlightSearchResult(currentSearchIndex);
+    } else {
+        serialModel->setHighlightedIndex(QModelIndex());
+    }
+}
+
+void MainWindow::performServerSearch(bool loadMore)
+{
+    const QString searchText = searchEdit->text().trimmed();
+    if (searchText.isEmpty()) {
+        return;
+    }
+
+    const int column = currentSearchColumn();
+    if (column < 0) {
+        return;
+    }
+    const QString columnName = searchColumnName(column);
+    const ActivationStore::SearchMatch match = prefixSearchCheck->isChecked()
+            ? ActivationStore::PrefixMatch : ActivationStore::SubstringMatch;
+
+    // 每页 200 个序列号；显示搜索结果期间暂停增量同步，避免无关序列号混入
+    static const int PageSize = 200;
+    if (!loadMore) {
+        serverSearchOffset = 0;
+    }
+    const int offset = serverSearchOffset;
+    const int serial = ++serverSearchSerial;
+    syncTimer->stop();
+
+    QElapsedTimer timer;
+    timer.start();
+    readWorker()->submit(this, [columnName, searchText, match, offset](ActivationStore &store) {
+        StoreResult<SearchPage> result;
+        result.ok = store.searchSerials(columnName, searchText, match, offset, PageSize, result.value);
+        result.error = store.lastError();
+        return result;
+    }, [this, serial, loadMore, column, searchText, timer](const StoreResult<SearchPage> &result) {
+        // 已经发起了新的搜索，或者已退出服务器搜索
+        if (serial != serverSearchSerial || !serverSearchCheck->isChecked()) {
+            return;
+        }
+        if (!result.ok) {
+            QMessageBox::critical(this, "错误", result.error);
+            return;
+        }
+
+        const SearchPage &page = result.value;
+        if (!loadMore) {
+            serialModel->setSerials(page.serials);
+            QVector<QVector<ActivationRecord>> activations(page.serials.size());
+            for (int i = 0; i < page.serials.size(); ++i) {
+                activations[i] = page.activations.value(page.serials.at(i).serialNumber);
+            }
+            serialModel->setActivations(activations);
+        } else {
+            for (const SerialRecord &record : page.serials) {
+                int row = serialModel->upsertSerial(record);
+                serialModel->setLoadedActivations(row, page.activations.value(record.serialNumber));
+            }
+        }
+        serverResultsShown = true;
+        serverSearchOffset += page.serials.size();
+        loadMoreButton->setVisible(page.hasMore);
+
+        qDebug() << "服务器搜索" << searchText << "返回" << page.serials.size() << "个序列号，耗时"
+                 << timer.elapsed() << "ms";
+        statusBar()->showMessage(QString("服务器搜索：已加载 %1 个序列号%2")
+                                     .arg(serialModel->rowCount())
+                                     .arg(page.hasMore ? "，点击“加载更多”继续" : ""));
+
+        // 在已加载的结果中定位并高亮
+        searchModel(column, searchText);
+    });
+}
 
-    // 执行搜索（包括主行和子行）
-    for (int i = 0; i < serialModel->rowCount(); ++i) {
-        QStandardItem *parentItem = serialModel->item(i);
+void MainWindow::fetchSearchMatches(int column, const QString &searchText)
+{
+    // 最多取 100 个命中的序列号，不超过模型常驻子树的上限
+    static const int Limit = 100;
+    const QString columnName = searchColumnName(column);
+    const int serial = ++serverSearchSerial;
+
+    readWorker()->submit(this, [columnName, searchText](ActivationStore &store) {
+        StoreResult<SearchPage> result;
+        result.ok = store.searchSerials(columnName, searchText, ActivationStore::SubstringMatch,
+                                        0, Limit, result.value);
+        result.error = store.lastError();
+        return result;
+    }, [this, serial, column, searchText](const StoreResult<SearchPage> &result) {
+        if (serial != serverSearchSerial) {
+            return;
+        }
+        if (!result.ok) {
+            qDebug() << "搜索激活信息失败:" << result.error;
+            return;
+        }
 
-        // 搜索主行
-        if (column < 9) {
-            QStandardItem *item = serialModel->item(i, column);
-            if (item && item->text().contains(searchText, Qt::CaseInsensitive)) {
-                searchResults.append(serialModel->index(i, column));
+        // 尚未加载到的序列号先追加到列表末尾，之后翻页到它们时只原位更新
+        for (const SerialRecord &record : result.value.serials) {
+            int row = serialModel->findSerial(record.serialNumber);
+            if (row < 0) {
+                row = serialModel->appendSerial(record);
+            }
+            if (column != SerialTreeModel::SerialNumberColumn && !serialModel->activationsLoaded(row)) {
+                serialModel->setLoadedActivations(row, result.value.activations.value(record.serialNumber));
             }
         }
+        searchModel(column, searchText, false);
 
-        // 搜索子行
-        for (int j = 0; j < parentItem->rowCount(); ++j) {
-            if (column >= 9) {
-                QStandardItem *childItem = parentItem->child(j, column-9);
-                if (childItem && childItem->text().contains(searchText, Qt::CaseInsensitive)) {
-                    searchResults.append(childItem->index());
-                }
-            }
+        // 结果不完整时，下一次输入不能只在本次结果中筛选
+        if (result.value.hasMore) {
+            invalidateSearch();
+            statusBar()->showMessage(QString("只显示前 %1 个序列号中的匹配项").arg(Limit), 5000);
         }
-    }
+    });
+}
 
-    if (!searchResults.isEmpty()) {
-        currentSearchIndex = 0;
-        highlightSearchResult(currentSearchIndex);
+void MainWindow::leaveServerSearch()
+{
+    ++serverSearchSerial;
+    loadMoreButton->setVisible(false);
+
+    // 恢复完整列表并继续增量同步
+    if (serverResultsShown) {
+        serverResultsShown = false;
+        statusBar()->clearMessage();
+        loadSerialNumbers();
     }
+    startSync();
 }
 
 void MainWindow::highlightSearchResult(int index)
@@ -427,14 +1264,10 @@ void MainWindow::highlightSearchResult(int index)
         return;
     }
 
-    // 清除所有高亮
-    clearSearchHighlights();
-
-    // 设置新的高亮
+    // 设置新的高亮（模型只通知新旧两项）
     QModelIndex resultIndex = searchResults[index];
-    QStandardItem *item = serialModel->itemFromIndex(resultIndex);
-    if (item) {
-        item->setBackground(Qt::yellow);
+    if (resultIndex.isValid()) {
+        serialModel->setHighlightedIndex(resultIndex);
 
         // 确保该项可见
         serialTableView->scrollTo(resultIndex);
@@ -471,23 +1304,22 @@ void MainWindow::findPrev()
 
 void MainWindow::clearSearchHighlights()
 {
-    /// 只清除实际有高亮的部分，提高性能
-    for (const QModelIndex &index : searchResults) {
-        QStandardItem *item = serialModel->itemFromIndex(index);
-        if (item) {
-            item->setBackground(QBrush());
-        }
-    }
+    // 高亮由模型的 BackgroundRole 提供
+    serialModel->setHighlightedIndex(QModelIndex());
+    serialModel->clearSearchMatches();
+    searchResults.clear();
+    currentSearchIndex = -1;
+    invalidateSearch();
+}
+
+void MainWindow::invalidateSearch()
+{
+    lastSearchText.clear();
 }
 
 void MainWindow::addSerialNumber()
 {
     QString serialNumber = serialNumberEdit->text().trimmed();
-    // 检查序列号是否已存在
-    if (isSerialNumberExists(serialNumber)) {
-        QMessageBox::warning(this, "警告", "该序列号已存在！");
-        return;
-    }
     QString totalActivations = totalActivationsEdit->text().trimmed();
     QString remainingActivations = remainingActivationsEdit->text().trimmed();
     QString platform = platformComboBox->currentText();
@@ -510,79 +1342,60 @@ void MainWindow::addSerialNumber()
         return;
     }
 
-    // 检查序列号是否已存在
-    QSqlQuery checkQuery;
-    checkQuery.prepare("SELECT COUNT(*) FROM serial_numbers WHERE serial_number = ?");
-    checkQuery.addBindValue(serialNumber);
-    if (checkQuery.exec() && checkQuery.next() && checkQuery.value(0).toInt() > 0) {
-        QMessageBox::warning(this, "警告", "该序列号已存在!");
-        return;
-    }
-
-    // 插入数据库
-    QSqlQuery query;
-    query.prepare("INSERT INTO serial_numbers (serial_number, total_activations, remaining_activations, "
-                 "platform, verification_code, license_file, kyinfo_file, bind_wechat, bind_person) "
-                 "VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?)");
-
-    query.addBindValue(serialNumber);
-    query.addBindValue(totalActivations.toInt());
-    query.addBindValue(remainingActivations.toInt());
-    query.addBindValue(platform);
-    query.addBindValue(verificationCode);
+    SerialRecord record;
+    record.serialNumber = serialNumber;
+    record.totalActivations = totalActivations.toInt();
+    record.remainingActivations = remainingActivations.toInt();
+    record.platform = platform;
+    record.verificationCode = verificationCode;
+    record.bindWechat = bindWechat;
+    record.bindPerson = bindPerson;
 
-    // 处理LICENSE文件
-    QByteArray licenseData;
+    // LICENSE/.kyinfo 文件在工作线程中按块读取并写入数据库
+    QString licensePath;
+    QString kyinfoPath;
     if (platform == "银河麒麟" && licenseFilePathLabel->text() != "未选择文件") {
-        QFile file(licenseFilePathLabel->text());
-        if (file.open(QIODevice::ReadOnly)) {
-            licenseData = file.readAll();
-            file.close();
-        }
+        licensePath = licenseFilePathLabel->text();
     }
-    query.addBindValue(licenseData);
-
-    // 处理.kyinfo文件
-    QByteArray kyinfoData;
     if (platform == "银河麒麟" && kyinfoFilePathLabel->text() != "未选择文件") {
-        QFile file(kyinfoFilePathLabel->text());
-        if (file.open(QIODevice::ReadOnly)) {
-            kyinfoData = file.readAll();
-            file.close();
-        }
+        kyinfoPath = kyinfoFilePathLabel->text();
     }
-    query.addBindValue(kyinfoData);
-
-    query.addBindValue(bindWechat);
-    query.addBindValue(bindPerson);
 
-    if (!query.exec()) {
-        QMessageBox::critical(this, "错误", "添加序列号失败: " + query.lastError().text());
-        return;
+    if (!licensePath.isEmpty()) {
+        record.licenseSize = QFileInfo(licensePath).size();
+    }
+    if (!kyinfoPath.isEmpty()) {
+        record.kyinfoSize = QFileInfo(kyinfoPath).size();
     }
 
-    // 更新UI
-    QList<QStandardItem*> items;
-    items << new QStandardItem(serialNumber);
-    items << new QStandardItem(totalActivations);
-    items << new QStandardItem(remainingActivations);
-    items << new QStandardItem(platform);
-    items << new QStandardItem(verificationCode);
-    items << new QStandardItem(licenseData.isEmpty() ? "无" : "有");
-    items << new QStandardItem(kyinfoData.isEmpty() ? "无" : "有");
-    items << new QStandardItem(bindWechat);
-    items << new QStandardItem(bindPerson);
-
-    serialModel->appendRow(items);
+    // 检查序列号是否已存在（包括尚未加载到列表中的）
+    addButton->setEnabled(false);
+    findExistingSerials(QStringList() << serialNumber, [this, record, licensePath, kyinfoPath](const QSet<QString> &existing) {
+        if (!existing.isEmpty()) {
+            addButton->setEnabled(true);
+            QMessageBox::warning(this, "警告", "该序列号已存在！");
+            return;
+        }
+        submitOperation(PendingOperation::addSerial(record, licensePath, kyinfoPath), [this, record](const QString &error, const SerialRecord &) {
+            addButton->setEnabled(true);
+            if (!error.isEmpty()) {
+                QMessageBox::critical(this, "错误", error);
+                return;
+            }
 
-    // 清空输入
-    serialNumberEdit->clear();
-    totalActivationsEdit->clear();
-    remainingActivationsEdit->clear();
-    verificationCodeEdit->clear();
-    licenseFilePathLabel->setText("未选择文件");
-    kyinfoFilePathLabel->setText("未选择文件");
-    bindPersonEdit->clear();
+            // 更新UI
+            serialModel->appendSerial(record);
+
+            // 清空输入
+            serialNumberEdit->clear();
+            totalActivationsEdit->clear();
+            remainingActivationsEdit->clear();
+            verificationCodeEdit->clear();
+            licenseFilePathLabel->setText("未选择文件");
+            kyinfoFilePathLabel->setText("未选择文件");
+            bindPersonEdit->clear();
+        });
+    });
 }
 
 void MainWindow::platformChanged(int index)
@@ -694,55 +1507,35 @@ void MainWindow::modifyChildItem()
                                           QLineEdit::Normal, index.data().toString(), &ok);
     if (!ok || newValue.isEmpty()) return;
 
-    // 开始事务
-    QSqlDatabase::database().transaction();
-
-    try {
-        // 获取父项的序列号
-        QString serialNumber = serialModel->itemFromIndex(index.parent())->text();
-        
-        // 获取原来的激活码(第9列)
-        QString oldActivationCode = serialModel->itemFromIndex(index.parent())
-                                    ->child(index.row(), 9)->text();
-
-        // 准备SQL更新
-        QSqlQuery query;
-        QString columnName;
-        switch(index.column()) {
-        case 9: columnName = "activation_code"; break;
-        case 10: columnName = "project_number"; break;
-        case 11: columnName = "chassis_number"; break;
-        }
-
-        query.prepare(QString("UPDATE activation_info SET %1 = ? WHERE serial_number = ? AND activation_code = ?")
-                     .arg(columnName));
-        query.addBindValue(newValue);
-        query.addBindValue(serialNumber);
-        query.addBindValue(oldActivationCode);
-
-        if (!query.exec()) {
-            throw std::runtime_error("更新数据库失败: " + query.lastError().text().toStdString());
-        }
+    // 获取父项的序列号和原来的激活码(第9列)
+    QString serialNumber = serialModel->serial(index.parent().row()).serialNumber;
+    QString oldActivationCode = serialModel->activation(index.parent().row(), index.row()).activationCode;
+    const int column = index.column();
 
-        // 更新UI模型
-        serialModel->itemFromIndex(index)->setText(newValue);
+    QString columnName;
+    switch(column) {
+    case 9: columnName = "activation_code"; break;
+    case 10: columnName = "project_number"; break;
+    case 11: columnName = "chassis_number"; break;
+    }
 
-        // 如果是修改激活码，需要更新oldActivationCode引用
-        if (index.column() == 9) {
-            // 可能需要更新其他引用此激活码的地方
+    submitOperation(PendingOperation::updateActivation(serialNumber, oldActivationCode, columnName, newValue),
+                    [this, serialNumber, oldActivationCode, column, newValue](const QString &error, const SerialRecord &) {
+        if (!error.isEmpty()) {
+            QMessageBox::critical(this, "错误", error);
+            refreshSerial(serialNumber);
+            return;
         }
 
-        // 提交事务
-        if (!QSqlDatabase::database().commit()) {
-            throw std::runtime_error("提交事务失败");
+        // 更新UI模型（请求期间行号可能变化，按序列号和激活码重新定位）
+        int serialRow = serialModel->findSerial(serialNumber);
+        int childRow = serialRow < 0 ? -1 : serialModel->findActivation(serialRow, oldActivationCode);
+        if (childRow >= 0) {
+            serialModel->setData(serialModel->index(childRow, column, serialModel->index(serialRow, 0)), newValue);
         }
 
         QMessageBox::information(this, "成功", "修改已保存");
-
-    } catch (const std::exception &e) {
-        QSqlDatabase::database().rollback();
-        QMessageBox::critical(this, "错误", QString::fromStdString(e.what()));
-    }
+    });
 }
 
 
@@ -758,65 +1551,30 @@ void MainWindow::deleteChildItem(const QModelIndex &index)
         return;
     }
 
-    // 获取父项(主行)的序列号
-    QStandardItem *parentItem = serialModel->itemFromIndex(index.parent());
-    if (!parentItem) {
-        qDebug() << "无法获取父项";
-        return;
-    }
-
-    QString serialNumber = parentItem->text();
+    // 获取父项(主行)的序列号和子项的激活码
+    const int serialRow = index.parent().row();
+    QString serialNumber = serialModel->serial(serialRow).serialNumber;
+    QString activationCode = serialModel->activation(serialRow, index.row()).activationCode;
 
-    // 获取子项的激活码（假设激活码在第9列，根据实际调整）
-    QStandardItem *childItem = serialModel->itemFromIndex(index.sibling(index.row(), 9));
-    if (!childItem) {
-        qDebug() << "无法获取子项的激活码";
-        return;
-    }
-    QString activationCode = childItem->text();
-
-    // 开始事务
-    QSqlDatabase::database().transaction();
-
-    try {
-        // 1. 从数据库删除激活信息
-        QSqlQuery deleteQuery;
-        deleteQuery.prepare("DELETE FROM activation_info WHERE serial_number = ? AND activation_code = ?");
-        deleteQuery.addBindValue(serialNumber);
-        deleteQuery.addBindValue(activationCode);
-
-        if (!deleteQuery.exec()) {
-            throw std::runtime_error("删除激活信息失败: " + deleteQuery.lastError().text().toStdString());
-        }
-
-        // 2. 更新主行的剩余激活次数（+1）
-        int remaining = serialModel->item(index.parent().row(), 2)->text().toInt() + 1;
-        serialModel->item(index.parent().row(), 2)->setText(QString::number(remaining));
-
-        QSqlQuery updateQuery;
-        updateQuery.prepare("UPDATE serial_numbers SET remaining_activations = ? WHERE serial_number = ?");
-        updateQuery.addBindValue(remaining);
-        updateQuery.addBindValue(serialNumber);
-
-        if (!updateQuery.exec()) {
-            throw std::runtime_error("更新剩余激活次数失败: " + updateQuery.lastError().text().toStdString());
+    // 剩余激活次数由服务器原子地加 1，界面只刷新这一行
+    submitOperation(PendingOperation::deleteActivation(serialNumber, activationCode),
+                    [this, serialNumber, activationCode](const QString &error, const SerialRecord &updated) {
+        if (!error.isEmpty()) {
+            QMessageBox::critical(this, "错误", error);
+            qDebug() << "删除子项时出错:" << error;
+            refreshSerial(serialNumber);
+            return;
         }
 
-        // 3. 从界面删除子项
-        parentItem->removeRow(index.row());
-
-        // 提交事务
-        if (!QSqlDatabase::database().commit()) {
-            throw std::runtime_error("提交事务失败");
+        // 更新主行的剩余激活次数，并从界面删除子项
+        int row = serialModel->findSerial(serialNumber);
+        if (row >= 0) {
+            serialModel->removeActivation(row, serialModel->findActivation(row, activationCode));
+            updateSerialRow(serialNumber, updated, 1);
         }
 
         qDebug() << "成功删除子项:" << activationCode << "序列号:" << serialNumber;
-
-    } catch (const std::exception &e) {
-        QSqlDatabase::database().rollback();
-        QMessageBox::critical(this, "错误", QString::fromStdString(e.what()));
-        qDebug() << "删除子项时出错:" << e.what();
-    }
+    });
 }
 
 void MainWindow::updateChildItemInDatabase(const QModelIndex &index)
@@ -824,11 +1582,10 @@ void MainWindow::updateChildItemInDatabase(const QModelIndex &index)
     if (!index.isValid() || !index.parent().isValid()) return;
 
     // 获取父项的序列号
-    QString serialNumber = serialModel->itemFromIndex(index.parent())->text();
-    
+    QString serialNumber = serialModel->serial(index.parent().row()).serialNumber;
+
     // 获取原来的激活码(第9列)
-    QString oldActivationCode = serialModel->itemFromIndex(index.parent())
-                                ->child(index.row(), 9)->text();
+    QString oldActivationCode = serialModel->activation(index.parent().row(), index.row()).activationCode;
 
     QString columnName;
     switch(index.column()) {
@@ -838,16 +1595,14 @@ void MainWindow::updateChildItemInDatabase(const QModelIndex &index)
     default: return;
     }
 
-    QSqlQuery query;
-    query.prepare(QString("UPDATE activation_info SET %1 = ? WHERE serial_number = ? AND activation_code = ?")
-                 .arg(columnName));
-    query.addBindValue(index.data().toString());
-    query.addBindValue(serialNumber);
-    query.addBindValue(oldActivationCode);
-
-    if (!query.exec()) {
-        qDebug() << "更新子项失败:" << query.lastError().text();
-    }
+    QString value = index.data().toString();
+    submitOperation(PendingOperation::updateActivation(serialNumber, oldActivationCode, columnName, value),
+                    [this, serialNumber](const QString &error, const SerialRecord &) {
+        if (!error.isEmpty()) {
+            qDebug() << "更新子项失败:" << error;
+            refreshSerial(serialNumber);
+        }
+    });
 }
 
 
@@ -863,10 +1618,26 @@ void MainWindow::modifySerialNumber()
     bool ok;
     QString newValue = QInputDialog::getText(this, "修改", "输入新值:", QLineEdit::Normal,
                                            index.data().toString(), &ok);
-    if (ok && !newValue.isEmpty()) {
-        serialModel->itemFromIndex(index)->setText(newValue);
-        updateSerialNumberInDatabase(index);
+    if (!ok || newValue.isEmpty()) return;
+
+    // 修改前记录原序列号，数据库按原值定位
+    QString serialNumber = serialModel->serial(index.row()).serialNumber;
+
+    if (index.column() != 0 || newValue == serialNumber) {
+        updateSerialNumberInDatabase(index, serialNumber, newValue);
+        return;
     }
+
+    const QPersistentModelIndex target(index);
+    findExistingSerials(QStringList() << newValue, [this, target, serialNumber, newValue](const QSet<QString> &existing) {
+        if (!existing.isEmpty()) {
+            QMessageBox::warning(this, "警告", "该序列号已存在！");
+            return;
+        }
+        if (target.isValid()) {
+            updateSerialNumberInDatabase(target, serialNumber, newValue);
+        }
+    });
 }
 
 void MainWindow::addActivationInfo()
@@ -883,89 +1654,44 @@ void MainWindow::addActivationInfo()
         return;
     }
 
-    QStandardItem *parentItem = serialModel->itemFromIndex(index);
-    if (!parentItem) {
-        qDebug() << "无法获取父项";
+    const int serialRow = index.row();
+    QString serialNumber = serialModel->serial(serialRow).serialNumber;
+    if (serialModel->serial(serialRow).remainingActivations <= 0) {
+        QMessageBox::warning(this, "提示", "该序列号没有剩余激活次数");
         return;
     }
-
-    QString serialNumber = serialModel->item(index.row(), 0)->text();
     activationDialog = new ActivationDialog(serialNumber, this);
 
-    if (activationDialog->exec() == QDialog::Accepted) {
-        // 开始事务
-        QSqlDatabase::database().transaction();
-
-        // 1. 数据库插入
-        QSqlQuery query;
-        query.prepare("INSERT INTO activation_info (serial_number, activation_code, project_number, chassis_number) "
-                    "VALUES (?, ?, ?, ?)");
-        query.addBindValue(serialNumber);
-        query.addBindValue(activationDialog->getActivationCode());
-        query.addBindValue(activationDialog->getProjectNumber());
-        query.addBindValue(activationDialog->getChassisNumber());
-
-        if (!query.exec()) {
-            QSqlDatabase::database().rollback();
-            QMessageBox::critical(this, "错误", "添加激活信息失败: " + query.lastError().text());
-            qDebug() << "数据库插入失败:" << query.lastError().text();
-            delete activationDialog;
-            return;
-        }
-
-        // 2. 添加子项（共9列，与主模型保持一致）
-        QList<QStandardItem*> childItems;
-        childItems << new QStandardItem("激活记录");  // 第0列
-        childItems << new QStandardItem(activationDialog->getActivationCode());  // 列1
-        childItems << new QStandardItem(activationDialog->getProjectNumber());   // 列2
-        childItems << new QStandardItem(activationDialog->getChassisNumber());   // 列3
-
-        // 填充剩余列（4-8）为空
-        for (int i = 4; i < 9; ++i) {
-            childItems << new QStandardItem("");
-        }
-
-        // 添加子项到主行
-        parentItem->appendRow(childItems);
-        qDebug() << "已添加子项，父项现在有" << parentItem->rowCount() << "个子行";
-
-        // 3. 更新剩余激活次数
-        int remaining = serialModel->item(index.row(), 2)->text().toInt() - 1;
-        serialModel->item(index.row(), 2)->setText(QString::number(remaining));
+    if (activationDialog->exec() != QDialog::Accepted) {
+        delete activationDialog;
+        return;
+    }
 
-        QSqlQuery updateQuery;
-        updateQuery.prepare("UPDATE serial_numbers SET remaining_activations = ? WHERE serial_number = ?");
-        updateQuery.addBindValue(remaining);
-        updateQuery.addBindValue(serialNumber);
+    ActivationRecord record;
+    record.activationCode = activationDialog->getActivationCode();
+    record.projectNumber = activationDialog->getProjectNumber();
+    record.chassisNumber = activationDialog->getChassisNumber();
+    delete activationDialog;
 
-        if (!updateQuery.exec()) {
-            QSqlDatabase::database().rollback();
-            QMessageBox::critical(this, "错误", "更新激活次数失败: " + updateQuery.lastError().text());
-            qDebug() << "更新激活次数失败:" << updateQuery.lastError().text();
-            delete activationDialog;
+    // 剩余激活次数由服务器原子地减 1（不低于 0），界面只刷新这一行
+    submitOperation(PendingOperation::addActivation(serialNumber, record),
+                    [this, serialNumber, record](const QString &error, const SerialRecord &updated) {
+        if (!error.isEmpty()) {
+            QMessageBox::critical(this, "错误", error);
+            refreshSerial(serialNumber);
             return;
         }
 
-        // 提交事务
-        if (!QSqlDatabase::database().commit()) {
-            QMessageBox::critical(this, "错误", "提交事务失败");
-            qDebug() << "提交事务失败";
-            delete activationDialog;
-            return;
+        // 只修补受影响的主行和新增子行，不重新加载整棵树，
+        // 其他行的展开状态、选中项和滚动位置保持不变
+        int row = serialModel->findSerial(serialNumber);
+        if (row >= 0) {
+            serialModel->appendActivation(row, record);
+            updateSerialRow(serialNumber, updated, -1);
+            serialTableView->expand(serialModel->index(row, 0));
+            qDebug() << "激活信息添加成功，剩余激活次数:" << serialModel->serial(row).remainingActivations;
         }
-
-        // 刷新视图
-        serialTableView->expand(index);
-        serialTableView->viewport()->update();
-        serialModel->layoutChanged();  // 强制刷新模型
-
-        qDebug() << "激活信息添加成功，剩余激活次数:" << remaining;
-    }
-
-    delete activationDialog;
-    // 加载数据
-    loadSerialNumbers();
-    loadActivationInfo();
+    });
 }
 
 void MainWindow::deleteSerialNumber()
@@ -977,98 +1703,216 @@ void MainWindow::deleteSerialNumber()
     QModelIndex index = serialTableView->currentIndex();
     if (!index.isValid() || index.parent().isValid()) return; // 确保是主行
 
-    QString serialNumber = serialModel->item(index.row(), 0)->text();
+    QString serialNumber = serialModel->serial(index.row()).serialNumber;
 
     // 从数据库删除主行和所有关联的子行
-    QSqlDatabase::database().transaction();
-
-    QSqlQuery query;
-    query.prepare("DELETE FROM activation_info WHERE serial_number = ?");
-    query.addBindValue(serialNumber);
-    if (!query.exec()) {
-        QSqlDatabase::database().rollback();
-        QMessageBox::critical(this, "错误", "删除关联激活信息失败: " + query.lastError().text());
-        return;
-    }
-
-    query.prepare("DELETE FROM serial_numbers WHERE serial_number = ?");
-    query.addBindValue(serialNumber);
-    if (!query.exec()) {
-        QSqlDatabase::database().rollback();
-        QMessageBox::critical(this, "错误", "删除序列号失败: " + query.lastError().text());
-        return;
-    }
-
-    QSqlDatabase::database().commit();
+    submitOperation(PendingOperation::deleteSerial(serialNumber),
+                    [this, serialNumber](const QString &error, const SerialRecord &) {
+        if (!error.isEmpty()) {
+            QMessageBox::critical(this, "错误", error);
+            return;
+        }
 
-    // 更新UI
-    serialModel->removeRow(index.row());
+        // 更新UI
+        serialModel->removeSerial(serialModel->findSerial(serialNumber));
+    });
 }
 
 void MainWindow::downloadLicense()
 {
-    QModelIndex index = serialTableView->currentIndex();
-    if (!index.isValid()) return;
+    downloadBlob(BlobStore::License);
+}
 
-    QString serialNumber = serialModel->item(index.row(), 0)->text();
+void MainWindow::downloadKyinfo()
+{
+    downloadBlob(BlobStore::Kyinfo);
+}
 
-    QSqlQuery query;
-    query.prepare("SELECT license_file FROM serial_numbers WHERE serial_number = ?");
-    query.addBindValue(serialNumber);
+void MainWindow::recompressBlobs()
+{
+    if (!verifyPassword()) {
+        return;
+    }
+    if (QMessageBox::question(this, "重新压缩", "将数据库中未压缩的 LICENSE/.kyinfo 文件块重新压缩，是否继续？")
+        != QMessageBox::Yes) {
+        return;
+    }
 
-    if (query.exec() && query.next()) {
-        QByteArray fileData = query.value(0).toByteArray();
-        if (fileData.isEmpty()) {
-            QMessageBox::information(this, "提示", "没有LICENSE文件");
+    QElapsedTimer timer;
+    timer.start();
+    statusBar()->showMessage("正在重新压缩文件...");
+    dbWorker->submit(this, [](ActivationStore &store) {
+        StoreResult<QVector<qint64>> result;
+        qint64 before = 0;
+        qint64 after = 0;
+        int chunks = 0;
+        result.ok = store.recompressBlobs(before, after, chunks);
+        result.error = store.lastError();
+        result.value << before << after << chunks;
+        return result;
+    }, [this, timer](const StoreResult<QVector<qint64>> &result) {
+        statusBar()->clearMessage();
+        if (!result.ok) {
+            QMessageBox::critical(this, "错误", "重新压缩失败: " + result.error);
             return;
         }
+        const qint64 before = result.value.at(0);
+        const qint64 after = result.value.at(1);
+        QMessageBox::information(this, "重新压缩",
+            QString("已压缩 %1 块，存储从 %2 KB 降至 %3 KB，节省 %4 KB，耗时 %5 秒")
+                .arg(result.value.at(2))
+                .arg(before / 1024).arg(after / 1024).arg((before - after) / 1024)
+                .arg(timer.elapsed() / 1000.0, 0, 'f', 1));
+    });
+}
 
-        QString savePath = QFileDialog::getSaveFileName(this, "保存LICENSE文件",
-                                                      "LICENSE", "License Files (LICENSE)");
-        if (!savePath.isEmpty()) {
-            QFile file(savePath);
-            if (file.open(QIODevice::WriteOnly)) {
-                file.write(fileData);
-                file.close();
-                QMessageBox::information(this, "成功", "LICENSE文件已保存");
-            } else {
-                QMessageBox::critical(this, "错误", "无法保存文件");
+void MainWindow::showQueryStats()
+{
+    // 统计由各工作线程共同写入，QueryMonitor 内部加锁，这里直接读取
+    QDialog dialog(this);
+    dialog.setWindowTitle("SQL 统计");
+    dialog.resize(1000, 500);
+    QVBoxLayout *layout = new QVBoxLayout(&dialog);
+
+    const QStringList headers = {"次数", "失败", "p50 (ms)", "p95 (ms)", "p99 (ms)", "最长 (ms)", "总耗时 (ms)",
+                                 "最近操作", "语句"};
+    QTableWidget *table = new QTableWidget(&dialog);
+    table->setColumnCount(headers.size());
+    table->setHorizontalHeaderLabels(headers);
+    table->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    table->setSelectionBehavior(QAbstractItemView::SelectRows);
+    table->horizontalHeader()->setStretchLastSection(true);
+    layout->addWidget(table);
+
+    auto fill = [table]() {
+        const QVector<QueryMonitor::Summary> summaries = QueryMonitor::summaries();
+        table->setRowCount(summaries.size());
+        for (int row = 0; row < summaries.size(); ++row) {
+            const QueryMonitor::Summary &summary = summaries.at(row);
+            const QStringList values = {
+                QString::number(summary.executions),
+                QString::number(summary.errors),
+                QString::number(summary.p50Ms, 'f', 2),
+                QString::number(summary.p95Ms, 'f', 2),
+                QString::number(summary.p99Ms, 'f', 2),
+                QString::number(summary.maxMs, 'f', 2),
+                QString::number(summary.totalMs, 'f', 1),
+                summary.lastOperation,
+                summary.sql
+            };
+            for (int column = 0; column < values.size(); ++column) {
+                QTableWidgetItem *item = new QTableWidgetItem(values.at(column));
+                if (column == values.size() - 1) {
+                    item->setToolTip(summary.sql);
+                }
+                table->setItem(row, column, item);
             }
         }
-    }
+        table->resizeColumnsToContents();
+    };
+    fill();
+
+    QHBoxLayout *buttonLayout = new QHBoxLayout();
+    QPushButton *refreshButton = new QPushButton("刷新", &dialog);
+    QPushButton *resetButton = new QPushButton("清空", &dialog);
+    QPushButton *closeButton = new QPushButton("关闭", &dialog);
+    buttonLayout->addWidget(refreshButton);
+    buttonLayout->addWidget(resetButton);
+    buttonLayout->addStretch();
+    buttonLayout->addWidget(closeButton);
+    layout->addLayout(buttonLayout);
+    connect(refreshButton, &QPushButton::clicked, &dialog, fill);
+    connect(resetButton, &QPushButton::clicked, &dialog, [fill]() {
+        QueryMonitor::reset();
+        fill();
+    });
+    connect(closeButton, &QPushButton::clicked, &dialog, &QDialog::accept);
+
+    dialog.exec();
 }
 
-void MainWindow::downloadKyinfo()
+void MainWindow::downloadBlob(BlobStore::Kind kind)
 {
     QModelIndex index = serialTableView->currentIndex();
     if (!index.isValid()) return;
 
-    QString serialNumber = serialModel->item(index.row(), 0)->text();
+    const bool isLicense = (kind == BlobStore::License);
+    const QString fileName = isLicense ? "LICENSE" : ".kyinfo";
+    const SerialRecord &record = serialModel->serial(serialModel->serialRowOf(index));
+    QString serialNumber = record.serialNumber;
+
+    // 列表中已记录文件大小，为 0 时无需访问数据库
+    if ((isLicense ? record.licenseSize : record.kyinfoSize) <= 0) {
+        QMessageBox::information(this, "提示", "没有" + fileName + "文件");
+        return;
+    }
 
-    QSqlQuery query;
-    query.prepare("SELECT kyinfo_file FROM serial_numbers WHERE serial_number = ?");
-    query.addBindValue(serialNumber);
+    QString filter = isLicense ? "License Files (LICENSE)" : "Kyinfo Files (.kyinfo)";
+    QString savePath = QFileDialog::getSaveFileName(this, "保存" + fileName + "文件",
+                                                  fileName, filter);
+    if (savePath.isEmpty()) {
+        return;
+    }
 
-    if (query.exec() && query.next()) {
-        QByteArray fileData = query.value(0).toByteArray();
-        if (fileData.isEmpty()) {
-            QMessageBox::information(this, "提示", "没有.kyinfo文件");
+    auto finished = [this, fileName](const StoreResult<qint64> &result) {
+        if (!result.ok) {
+            QMessageBox::critical(this, "错误", "保存" + fileName + "文件失败: " + result.error);
             return;
         }
-
-        QString savePath = QFileDialog::getSaveFileName(this, "保存.kyinfo文件",
-                                                      ".kyinfo", "Kyinfo Files (.kyinfo)");
-        if (!savePath.isEmpty()) {
-            QFile file(savePath);
-            if (file.open(QIODevice::WriteOnly)) {
-                file.write(fileData);
-                file.close();
-                QMessageBox::information(this, "成功", ".kyinfo文件已保存");
-            } else {
-                QMessageBox::critical(this, "错误", "无法保存文件");
-            }
+        if (result.value == 0) {
+            QMessageBox::information(this, "提示", "没有" + fileName + "文件");
+            return;
         }
+        QMessageBox::information(this, "成功", fileName + "文件已保存");
+    };
+
+    // 在工作线程中按块从数据库读出并直接写入文件，下载过的文件存入本地缓存
+    auto fromServer = [this, serialNumber, kind, savePath, finished]() {
+        dbWorker->submit(this, [serialNumber, kind, savePath](ActivationStore &store) {
+            StoreResult<qint64> result;
+            result.ok = store.exportBlob(serialNumber, kind, savePath, result.value);
+            result.error = store.lastError();
+            return result;
+        }, [this, savePath, finished](const StoreResult<qint64> &result) {
+            finished(result);
+            if (!result.ok || result.value == 0 || !cacheReady) {
+                return;
+            }
+            cacheWorker->submit(this, [savePath](ActivationStore &store) {
+                StoreResult<bool> cached;
+                cached.ok = store.cacheBlob(savePath);
+                cached.error = store.lastError();
+                return cached;
+            }, [](const StoreResult<bool> &cached) {
+                if (!cached.ok) {
+                    qDebug() << "缓存文件失败:" << cached.error;
+                }
+            });
+        });
+    };
+    if (!cacheReady) {
+        fromServer();
+        return;
     }
+
+    // 缓存中已有内容时不访问服务器；value 为 -1 表示未缓存
+    cacheWorker->submit(this, [serialNumber, kind, savePath](ActivationStore &store) {
+        StoreResult<qint64> result;
+        result.value = -1;
+        bool cached = false;
+        result.ok = store.isBlobCached(serialNumber, kind, cached);
+        if (result.ok && cached) {
+            result.ok = store.exportBlob(serialNumber, kind, savePath, result.value);
+        }
+        result.error = store.lastError();
+        return result;
+    }, [finished, fromServer](const StoreResult<qint64> &result) {
+        if (result.ok && result.value >= 0) {
+            finished(result);
+            return;
+        }
+        fromServer();
+    });
 }
 
 bool MainWindow::verifyPassword()
@@ -1086,9 +1930,9 @@ bool MainWindow::verifyPassword()
     return false;
 }
 
-void MainWindow::updateSerialNumberInDatabase(const QModelIndex &index)
+void MainWindow::updateSerialNumberInDatabase(const QModelIndex &index, const QString &serialNumber,
+                                              const QString &value)
 {
-    QString serialNumber = serialModel->item(index.row(), 0)->text();
     QString columnName;
 
     switch (index.column()) {
@@ -1097,257 +1941,378 @@ void MainWindow::updateSerialNumberInDatabase(const QModelIndex &index)
     case 2: columnName = "remaining_activations"; break;
     case 3: columnName = "platform"; break;
     case 4: columnName = "verification_code"; break;
-    case 5: columnName = "license_file"; break;
-    case 6: columnName = "kyinfo_file"; break;
     case 7: columnName = "bind_wechat"; break;
     case 8: columnName = "bind_person"; break;
-    default: return;
+    default:
+        QMessageBox::warning(this, "警告", "不能修改此列");
+        return;
     }
 
-    QSqlQuery query;
-    query.prepare(QString("UPDATE serial_numbers SET %1 = ? WHERE serial_number = ?").arg(columnName));
-    query.addBindValue(index.data().toString());
-    query.addBindValue(serialNumber);
-    query.exec();
-}
-
-void MainWindow::updateActivationInfoInDatabase(const QString &serialNumber, const QModelIndex &index)
-{
-    int row = index.row();
-    QString activationCode = activationModels[serialNumber]->item(row, 0)->text();
-
-    QString columnName;
-    switch (index.column()) {
-    case 0: columnName = "activation_code"; break;
-    case 1: columnName = "project_number"; break;
-    case 2: columnName = "chassis_number"; break;
-    default: return;
-    }
+    // 带上界面上的行版本，其他工作站已修改过这一行时服务器拒绝覆盖
+    const int column = index.column();
+    const int version = serialModel->serial(index.row()).version;
+    submitOperation(PendingOperation::updateSerial(serialNumber, columnName, value, version),
+                    [this, serialNumber, column, value](const QString &error, const SerialRecord &updated) {
+        if (!error.isEmpty()) {
+            QMessageBox::critical(this, "错误", error);
+            refreshSerial(serialNumber);
+            return;
+        }
 
-    QSqlQuery query;
-    query.prepare(QString("UPDATE activation_info SET %1 = ? WHERE serial_number = ? AND activation_code = ?").arg(columnName));
-    query.addBindValue(index.data().toString());
-    query.addBindValue(serialNumber);
-    query.addBindValue(activationCode);
-    query.exec();
+        // 序列号本身被修改时模型会同步索引
+        int row = serialModel->findSerial(serialNumber);
+        if (row >= 0) {
+            serialModel->setData(serialModel->index(row, column), value);
+            updateSerialRow(column == SerialTreeModel::SerialNumberColumn ? value : serialNumber, updated, 0);
+        }
+    });
 }
 
-CSVData MainWindow::parseCSVFile(const QString &filePath) {
-    CSVData data;
-    QFile file(filePath);
-
-    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
-        qDebug() << "无法打开CSV文件:" << file.errorString();
-        return data;
+void MainWindow::addDataToSystem(const QVector<ImportItem> &plan, QStringList summary)
+{
+    if (plan.isEmpty()) {
+        setImporting(false);
+        showImportSummary(summary, 0, 0);
+        return;
     }
 
-    QTextStream in(&file);
-    bool isHeader = true;
-    bool isMainData = false;
-    bool isActivationData = false;
-
-    while (!in.atEnd()) {
-        QString line = in.readLine().trimmed();
-
-        if (line.isEmpty()) continue;
-
-        if (line.contains("激活数据表")) {
-            isMainData = true;
-            continue;
-        }
-
-        if (line.contains("注册码,激活码")) {
-            isHeader = false;
-            isActivationData = true;
-            continue;
+    // 整个导入计划作为一个请求提交；每个序列号单独成事务，
+    // 某个文件失败不影响其他文件。离线或中途断开时，未提交的部分写入离线日志
+    const bool direct = serverOnline && journal->isEmpty();
+    const bool mirror = cacheReady;
+    dbWorker->submit(this, [plan, direct, mirror](ActivationStore &store) {
+        StoreResult<ImportResult> result;
+        result.ok = true;
+        if (!direct) {
+            return result;
         }
-
-        if (isMainData && !isActivationData) {
-            // 处理主数据行，需要更智能的解析方式
-            if (line.contains("服务序列号")) {
-                // 示例行: "服务序列号,63261116,授权总数,6,"
-                QStringList parts = line.split(",");
-                for (int i = 0; i < parts.size(); i++) {
-                    if (parts[i].contains("服务序列号") && (i+1) < parts.size()) {
-                        data.serialNumber = parts[i+1].trimmed();
-                    }
-                    if (parts[i].contains("授权总数") && (i+1) < parts.size()) {
-                        data.totalActivations = parts[i+1].toInt();
-                    }
-                }
+        QStringList imported;
+        result.value.errors.reserve(plan.size());
+        for (const ImportItem &item : plan) {
+            const bool ok = store.importCsv(item.data);
+            const QString error = store.lastError();
+            if (!ok && !store.checkConnection()) {
+                result.ok = false;
+                break;
             }
-            else if (line.contains("可分配/可取消")) {
-                // 示例行: "激活方式,扫码,可分配/可取消,2/0,"
-                QStringList parts = line.split(",");
-                for (int i = 0; i < parts.size(); i++) {
-                    if (parts[i].contains("可分配/可取消") && (i+1) < parts.size()) {
-                        QStringList allocParts = parts[i+1].split("/");
-                        if (allocParts.size() >= 1) {
-                            data.remainingActivations = allocParts[0].toInt();
-                            qDebug() << "可分配数量:" << data.remainingActivations;
-                        }
-                    }
-                }
+            result.value.errors.append(error);
+            if (ok) {
+                imported.append(item.data.serialNumber);
             }
         }
+        if (mirror && !imported.isEmpty()) {
+            loadFresh(store, imported, result.value.fresh);
+        }
+        return result;
+    }, [this, plan, summary, mirror](const StoreResult<ImportResult> &result) mutable {
+        QStringList errors = result.value.errors;
+        if (mirror && !result.value.fresh.serials.isEmpty()) {
+            mirrorToCache(result.value.fresh, false);
+        }
+        if (!result.ok) {
+            goOffline();
+        }
+        for (int i = errors.size(); i < plan.size(); ++i) {
+            QString error;
+            queueOperation(PendingOperation::importCsv(plan.at(i).data), error);
+            errors.append(error);
+        }
 
-        if (isActivationData && !isHeader) {
-            // 处理激活码数据行
-            QStringList parts = line.split(",");
-            if (parts.size() >= 2) {
-                QString regCode = parts[0].trimmed();
-                QString actCode = parts[1].trimmed();
-                if (!regCode.isEmpty() && !actCode.isEmpty()) {
-                    data.activationCodes.append(qMakePair(regCode, actCode));
-                }
+        int imported = 0;
+        int failed = 0;
+        int lastRow = -1;
+        for (int i = 0; i < plan.size(); ++i) {
+            const ImportItem &item = plan.at(i);
+            const CSVData &data = item.data;
+            if (!errors.at(i).isEmpty()) {
+                ++failed;
+                summary.append(QString("%1：失败，%2").arg(item.fileName, errors.at(i)));
+                continue;
             }
-        }
-    }
 
-    file.close();
+            // 更新UI
+            SerialRecord record;
+            record.serialNumber = data.serialNumber;
+            record.totalActivations = data.totalActivations;
+            record.remainingActivations = data.remainingActivations;
+            record.bindWechat = "是";
+            record.bindPerson = "Excel导入";
+            int row = serialModel->upsertSerial(record);
+
+            // 添加子行（激活码）
+            QVector<ActivationRecord> children;
+            children.reserve(data.activationCodes.size());
+            for (const auto &codePair : data.activationCodes) {
+                ActivationRecord child;
+                child.activationCode = codePair.second;
+                children.append(child);
+            }
+            serialModel->replaceActivations(row, children);
+
+            ++imported;
+            lastRow = row;
+            summary.append(QString("%1：导入序列号 %2，包含 %3 个激活码")
+                               .arg(item.fileName, data.serialNumber)
+                               .arg(data.activationCodes.size()));
+        }
+        setImporting(false);
 
-    // qDebug() << "解析结果:";
-    // qDebug() << "服务序列号:" << data.serialNumber;
-    // qDebug() << "授权总数:" << data.totalActivations;
-    // qDebug() << "可分配数量:" << data.remainingActivations;
-    // qDebug() << "激活码数量:" << data.activationCodes.size();
+        // 只导入一个文件时展开显示
+        if (imported == 1) {
+            serialTableView->expand(serialModel->index(lastRow, 0));
+        }
 
-    return data;
+        showImportSummary(summary, imported, failed);
+    });
 }
 
-bool MainWindow::addDataToSystem(const CSVData &data)
+void MainWindow::showImportSummary(const QStringList &summary, int imported, int failed)
 {
-    // 检查序列号是否已存在
-    if (isSerialNumberExists(data.serialNumber)) {
-        QMessageBox::warning(this, "警告",
-            QString("序列号 %1 已存在，跳过导入").arg(data.serialNumber));
-        return false;
-    }
+    // 每个文件一行，汇总在一个对话框中
+    const int skipped = summary.size() - imported - failed;
+    QMessageBox box(failed > 0 || imported == 0 ? QMessageBox::Warning : QMessageBox::Information,
+                    "导入结果",
+                    QString("共 %1 个文件：成功 %2 个，失败 %3 个，跳过 %4 个")
+                        .arg(summary.size()).arg(imported).arg(failed).arg(skipped),
+                    QMessageBox::Ok, this);
+    box.setDetailedText(summary.join("\n"));
+    box.exec();
+}
 
-    // 开始事务
-    QSqlDatabase::database().transaction();
-
-    try {
-        // 1. 插入主行数据到数据库
-        QSqlQuery mainQuery;
-        mainQuery.prepare(
-            "INSERT INTO serial_numbers "
-            "(serial_number, total_activations, remaining_activations, "
-            "platform, bind_wechat, bind_person) "
-            "VALUES (?, ?, ?, '?', '是', 'Excel导入')");
-
-        mainQuery.addBindValue(data.serialNumber);
-        mainQuery.addBindValue(data.totalActivations);
-        mainQuery.addBindValue(data.remainingActivations);
-
-        if (!mainQuery.exec()) {
-            throw std::runtime_error(
-                QString("插入序列号失败: %1").arg(mainQuery.lastError().text()).toStdString());
-        }
-
-        // 2. 插入激活码到数据库
-        for (const auto &codePair : data.activationCodes) {
-            QSqlQuery codeQuery;
-            codeQuery.prepare(
-                    "INSERT INTO activation_info "
-                    "(serial_number, activation_code, project_number, chassis_number) "  // 添加这两个字段
-                    "VALUES (?, ?, '', '')");  // 初始化为空字符串
-            codeQuery.addBindValue(data.serialNumber);
-            codeQuery.addBindValue(codePair.second); // 使用激活码
-
-            if (!codeQuery.exec()) {
-                qDebug() << "激活码插入失败:" << codeQuery.lastError();
-                // 继续插入其他激活码
-            }
-        }
+void MainWindow::importFromCSV() {
+    QStringList filePaths = QFileDialog::getOpenFileNames(
+        this, "选择CSV文件", "", "CSV文件 (*.csv)");
 
-        // 3. 更新UI
-        QList<QStandardItem*> mainRow;
-        mainRow << new QStandardItem(data.serialNumber);
-        mainRow << new QStandardItem(QString::number(data.totalActivations));
-        mainRow << new QStandardItem(QString::number(data.remainingActivations));
-        mainRow << new QStandardItem("");
-        mainRow << new QStandardItem(""); // 验证码
-        mainRow << new QStandardItem("无"); // LICENSE
-        mainRow << new QStandardItem("无"); // .kyinfo
-        mainRow << new QStandardItem("是"); // 绑定微信
-        mainRow << new QStandardItem("Excel导入"); // 绑定人
-
-        QStandardItem *parentItem = mainRow.first();
-        serialModel->appendRow(mainRow);
-
-        // 添加子行（激活码）
-        for (const auto &codePair : data.activationCodes) {
-            QList<QStandardItem*> childRow;
-            // 前9列留空（与主行对应）
-            for (int i = 0; i < 9; ++i) {
-                childRow << new QStandardItem("");
-            }
-            // 激活码在第9列
-            childRow << new QStandardItem(codePair.second);
-            // 添加空的第10列（项目号）
-            childRow << new QStandardItem("");
-            // 添加空的第11列（机箱序列号）
-            childRow << new QStandardItem("");
-            parentItem->appendRow(childRow);
-        }
+    if (filePaths.isEmpty()) return;
 
-        // 展开显示
-        serialTableView->expand(parentItem->index());
+    importCsvFiles(filePaths);
+}
 
-        // 提交事务
-        if (!QSqlDatabase::database().commit()) {
-            throw std::runtime_error("提交事务失败");
-        }
+void MainWindow::importFromDirectory()
+{
+    QString dirPath = QFileDialog::getExistingDirectory(this, "选择CSV文件所在目录");
+    if (dirPath.isEmpty()) return;
 
-        return true;
+    QDir dir(dirPath);
+    QStringList filePaths;
+    for (const QString &name : dir.entryList(QStringList() << "*.csv" << "*.CSV", QDir::Files, QDir::Name)) {
+        filePaths.append(dir.filePath(name));
+    }
+    filePaths.removeDuplicates();
 
-    } catch (const std::exception &e) {
-        QSqlDatabase::database().rollback();
-        QMessageBox::critical(this, "错误", QString::fromStdString(e.what()));
-        return false;
+    if (filePaths.isEmpty()) {
+        QMessageBox::warning(this, "警告", "该目录下没有CSV文件");
+        return;
     }
-}
 
-void MainWindow::importFromCSV() {
-    QString filePath = QFileDialog::getOpenFileName(
-        this, "选择CSV文件", "", "CSV文件 (*.csv)");
+    importCsvFiles(filePaths);
+}
 
-    if (filePath.isEmpty()) return;
+void MainWindow::exportData()
+{
+    // 导出选项：选择导出的列，可按某一列的前缀筛选
+    QDialog dialog(this);
+    dialog.setWindowTitle("导出");
+    QVBoxLayout *layout = new QVBoxLayout(&dialog);
+    layout->addWidget(new QLabel("导出的列:", &dialog));
+    const QStringList fields = DataExporter::fieldNames();
+    QList<QCheckBox *> fieldChecks;
+    for (const QString &field : fields) {
+        QCheckBox *check = new QCheckBox(field, &dialog);
+        check->setChecked(true);
+        layout->addWidget(check);
+        fieldChecks.append(check);
+    }
+    QHBoxLayout *filterLayout = new QHBoxLayout();
+    QComboBox *filterCombo = new QComboBox(&dialog);
+    filterCombo->addItem("不筛选");
+    filterCombo->addItems(fields);
+    QLineEdit *filterEdit = new QLineEdit(&dialog);
+    filterEdit->setPlaceholderText("前缀");
+    filterLayout->addWidget(new QLabel("筛选:", &dialog));
+    filterLayout->addWidget(filterCombo);
+    filterLayout->addWidget(filterEdit);
+    layout->addLayout(filterLayout);
+    QDialogButtonBox *buttons = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel, &dialog);
+    layout->addWidget(buttons);
+    connect(buttons, &QDialogButtonBox::accepted, &dialog, &QDialog::accept);
+    connect(buttons, &QDialogButtonBox::rejected, &dialog, &QDialog::reject);
+    if (dialog.exec() != QDialog::Accepted) {
+        return;
+    }
 
-    // 解析CSV文件
-    CSVData data = parseCSVFile(filePath);
+    ExportOptions options;
+    for (QCheckBox *check : fieldChecks) {
+        if (check->isChecked()) {
+            options.fields.append(check->text());
+        }
+    }
+    if (options.fields.isEmpty()) {
+        QMessageBox::warning(this, "警告", "请至少选择一列");
+        return;
+    }
+    if (filterCombo->currentIndex() > 0 && !filterEdit->text().isEmpty()) {
+        options.filterColumn = filterCombo->currentText();
+        options.filterText = filterEdit->text();
+    }
 
-    if (data.serialNumber.isEmpty()) {
-        QMessageBox::warning(this, "警告", "CSV文件格式不正确或没有有效数据");
+    const QString filePath = QFileDialog::getSaveFileName(this, "导出", "activations.csv",
+                                                          "CSV文件 (*.csv);;NDJSON文件 (*.ndjson *.jsonl)");
+    if (filePath.isEmpty()) {
         return;
     }
+    options.format = ExportOptions::formatForFile(filePath);
+
+    // 导出在工作线程中分块进行，每块结束时更新进度并检查是否取消；
+    // 进度对话框只在导出结束后删除，工作线程投递进度时它一定还存在
+    QProgressDialog *progressDialog = new QProgressDialog("正在导出...", "取消", 0, 100, this);
+    progressDialog->setWindowModality(Qt::WindowModal);
+    progressDialog->setMinimumDuration(500);
+    QSharedPointer<QAtomicInt> cancelled(new QAtomicInt(0));
+    connect(progressDialog, &QProgressDialog::canceled, this, [cancelled]() {
+        cancelled->store(1);
+    });
+    exportButton->setEnabled(false);
+
+    QElapsedTimer timer;
+    timer.start();
+    readWorker()->submit(this, [options, filePath, cancelled, progressDialog](ActivationStore &store) {
+        StoreResult<ExportSummary> result;
+        // 写到临时文件，完成后再替换目标文件；取消或失败时不留下不完整的文件
+        QSaveFile file(filePath);
+        if (!file.open(QIODevice::WriteOnly)) {
+            result.error = "无法写入文件: " + file.errorString();
+            return result;
+        }
+        result.ok = store.exportData(options, &file, [cancelled, progressDialog](qint64 done, qint64 total) {
+            const int percent = total > 0 ? int(done * 100 / total) : 100;
+            QMetaObject::invokeMethod(progressDialog, [progressDialog, percent]() {
+                progressDialog->setValue(percent);
+            }, Qt::QueuedConnection);
+            return cancelled->load() == 0;
+        }, result.value);
+        result.error = store.lastError();
+        if (result.ok && !result.value.cancelled) {
+            if (!file.commit()) {
+                result.ok = false;
+                result.error = "无法写入文件: " + file.errorString();
+            }
+        } else {
+            file.cancelWriting();
+        }
+        return result;
+    }, [this, progressDialog, timer](const StoreResult<ExportSummary> &result) {
+        progressDialog->close();
+        progressDialog->deleteLater();
+        exportButton->setEnabled(true);
+
+        if (!result.ok) {
+            QMessageBox::critical(this, "错误", "导出失败: " + result.error);
+            return;
+        }
+        if (result.value.cancelled) {
+            statusBar()->showMessage("导出已取消", 3000);
+            return;
+        }
+        QMessageBox::information(this, "导出",
+            QString("已导出序列号 %1 个，共 %2 行（%3 KB），耗时 %4 秒")
+                .arg(result.value.serials).arg(result.value.rows).arg(result.value.bytes / 1024)
+                .arg(timer.elapsed() / 1000.0, 0, 'f', 1));
+    });
+}
 
-    // 添加到系统
-    if (addDataToSystem(data)) {
-        QMessageBox::information(this, "成功",
-            QString("成功导入序列号 %1\n包含 %2 个激活码")
-                .arg(data.serialNumber)
-                .arg(data.activationCodes.size()));
+void MainWindow::setImporting(bool importing)
+{
+    importButton->setEnabled(!importing);
+    importDirButton->setEnabled(!importing);
+    if (!importing) {
+        statusBar()->clearMessage();
     }
 }
 
-bool MainWindow::isSerialNumberExists(const QString &serialNumber)
+void MainWindow::importCsvFiles(const QStringList &filePaths)
+{
+    setImporting(true);
+    statusBar()->showMessage(QString("正在解析 %1 个CSV文件...").arg(filePaths.size()));
+
+    // 各文件互不相关，在线程池中并行解析，界面线程只负责汇总
+    QElapsedTimer timer;
+    timer.start();
+    QFutureWatcher<CSVData> *watcher = new QFutureWatcher<CSVData>(this);
+    connect(watcher, &QFutureWatcher<CSVData>::progressValueChanged, this, [this, filePaths](int done) {
+        statusBar()->showMessage(QString("正在解析CSV文件 %1/%2").arg(done).arg(filePaths.size()));
+    });
+    connect(watcher, &QFutureWatcher<CSVData>::finished, this, [this, watcher, filePaths, timer]() {
+        // mapped 的结果与输入文件一一对应
+        const QList<CSVData> results = watcher->future().results();
+        watcher->deleteLater();
+        qDebug() << "解析" << filePaths.size() << "个CSV文件耗时" << timer.elapsed() << "ms";
+
+        // 已存在的序列号在数据库中按批查找，包括尚未加载到列表中的
+        QStringList candidates;
+        for (const CSVData &data : results) {
+            if (!data.serialNumber.isEmpty()) {
+                candidates.append(data.serialNumber);
+            }
+        }
+        findExistingSerials(candidates, [this, results, filePaths](const QSet<QString> &existing) {
+            // 合并为一个导入计划：格式错误、已存在、批内重复的序列号在此跳过
+            QVector<ImportItem> plan;
+            QStringList summary;
+            QSet<QString> planned;
+            for (int i = 0; i < results.size(); ++i) {
+                const QString fileName = QFileInfo(filePaths.at(i)).fileName();
+                const CSVData &data = results.at(i);
+                if (data.serialNumber.isEmpty()) {
+                    summary.append(QString("%1：跳过，格式不正确或没有有效数据").arg(fileName));
+                } else if (existing.contains(data.serialNumber)) {
+                    summary.append(QString("%1：跳过，序列号 %2 已存在").arg(fileName, data.serialNumber));
+                } else if (planned.contains(data.serialNumber)) {
+                    summary.append(QString("%1：跳过，序列号 %2 与其他文件重复").arg(fileName, data.serialNumber));
+                } else {
+                    planned.insert(data.serialNumber);
+                    plan.append(ImportItem{fileName, data});
+                }
+            }
+
+            statusBar()->showMessage(QString("正在导入 %1 个序列号...").arg(plan.size()));
+            addDataToSystem(plan, summary);
+        });
+    });
+    watcher->setFuture(QtConcurrent::mapped(filePaths, &CsvParser::parseFile));
+}
+
+void MainWindow::findExistingSerials(const QStringList &serialNumbers,
+                                     std::function<void(const QSet<QString> &)> done)
 {
-    // 检查界面中是否存在
-    for (int i = 0; i < serialModel->rowCount(); ++i) {
-        if (serialModel->item(i, 0)->text() == serialNumber) {
-            return true;
+    // 界面中已有的（包括离线日志中尚未提交的）直接判断，其余在数据库中查找；
+    // 查询失败时只按界面判断，并发插入的重复序列号由数据库主键约束兜底
+    QSet<QString> existing;
+    QStringList unknown;
+    for (const QString &serialNumber : serialNumbers) {
+        if (serialModel->findSerial(serialNumber) >= 0) {
+            existing.insert(serialNumber);
+        } else {
+            unknown.append(serialNumber);
         }
     }
-
-    // 检查数据库中是否存在
-    QSqlQuery query;
-    query.prepare("SELECT COUNT(*) FROM serial_numbers WHERE serial_number = ?");
-    query.addBindValue(serialNumber);
-    if (query.exec() && query.next()) {
-        return query.value(0).toInt() > 0;
+    if (unknown.isEmpty()) {
+        done(existing);
+        return;
     }
 
-    return false;
+    readWorker()->submit(this, [unknown](ActivationStore &store) {
+        StoreResult<QVector<SerialRecord>> result;
+        result.ok = store.loadSerials(unknown, result.value);
+        result.error = store.lastError();
+        return result;
+    }, [existing, done](const StoreResult<QVector<SerialRecord>> &result) mutable {
+        if (!result.ok) {
+            qDebug() << "查询已存在的序列号失败:" << result.error;
+        }
+        for (const SerialRecord &record : result.value) {
+            existing.insert(record.serialNumber);
+        }
+        done(existing);
+    });
 }
@@ -2,8 +2,6 @@
 #define MAINWINDOW_H
 
 #include <QMainWindow>
-#include <QSqlDatabase>
-#include <QStandardItemModel>
 #include <QMap>
 #include <QGroupBox>
 #include <QLineEdit>
@@ -19,17 +17,17 @@
 #include <QInputDialog>
 #include <QHeaderView>
 #include <QShortcut>
-#include <QTextStream>
+#include <QProgressBar>
+#include <QTimer>
+#include <QCheckBox>
+#include <QScopedPointer>
+#include "blobstore.h"
+#include "serialtreemodel.h"
+#include "databaseworker.h"
+#include "operationjournal.h"
 
 class ActivationDialog;
 
-struct CSVData {
-    QString serialNumber;//序列号
-    int totalActivations = 0;//总激活次数
-    int remainingActivations = 0;//剩余激活次数
-    QVector<QPair<QString, QString>> activationCodes;//激活码
-};
-
 class MainWindow : public QMainWindow
 {
     Q_OBJECT
@@ -52,6 +50,10 @@ private slots:
     void downloadLicense();
     void downloadKyinfo();
     void importFromCSV();
+    void importFromDirectory();
+    void exportData();
+    void recompressBlobs();
+    void showQueryStats();
 private:
 
     // UI 组件
@@ -89,38 +91,108 @@ private:
     QTreeView *serialTableView;
     
     // 数据模型
-    QStandardItemModel *serialModel;
-    QMap<QString, QStandardItemModel*> activationModels;
+    SerialTreeModel *serialModel;
     ActivationDialog *activationDialog;
 
     // 数据库
-    QSqlDatabase db;
+    DatabaseWorker *dbWorker;
+    QProgressBar *busyIndicator;
+
+    // 本地 SQLite 缓存：启动时先从缓存显示，读取走缓存，写入仍直接提交到服务器
+    DatabaseWorker *cacheWorker;  // 未启用缓存时为空
+    bool cacheReady;              // 缓存已完整同步过，可用于读取
+    bool serverOnline;
+    bool refreshingCache;
+    bool refreshFailed;           // 全量刷新中有一页没有写入缓存
+    qint64 refreshCursor;         // 全量刷新开始时的变更日志位置
+    QSet<QString> refreshSeen;    // 全量刷新中服务器上存在的序列号
+    QLabel *offlineLabel;
+
+    // 离线操作日志：服务器不可用时修改先写入本地，恢复连接后按顺序提交
+    QScopedPointer<OperationJournal> journal;
+    QTimer *reconnectTimer;
+    int reconnectDelay;           // 重连间隔，失败后翻倍
+    bool serverLoaded;            // 连接成功后的初始加载已完成
+    bool replaying;
+    QStringList replayConflicts;
+
+    // 多工作站同步
+    QTimer *syncTimer;
+    qint64 changeCursor;  // 此 id 及之前的变更日志都已应用
+    QSet<qint64> changePending;  // 游标之后已应用的变更日志 id
+    bool syncing;
 
     // 添加搜索相关成员
     QShortcut *searchShortcut;
+    QShortcut *recompressShortcut;
+    QShortcut *queryStatsShortcut;
     QDialog *searchDialog;
     QLineEdit *searchEdit;
     QPushButton *searchNextButton;
     QPushButton *searchPrevButton;
     QComboBox *searchFieldCombo;
-    QList<QModelIndex> searchResults;
+    QList<QPersistentModelIndex> searchResults;
     int currentSearchIndex;
+    QTimer *searchTimer;       // 输入停顿后再搜索
+    QString lastSearchText;    // searchResults 对应的查询，仅在数据未变化时用于缩小结果
+    int lastSearchColumn;
+
+    // 服务器端搜索：只把命中的序列号及其子行加载到界面
+    QCheckBox *serverSearchCheck;
+    QCheckBox *prefixSearchCheck;
+    QPushButton *loadMoreButton;
+    bool serverResultsShown;
+    int serverSearchOffset;
+    int serverSearchSerial;  // 只处理最近一次搜索的结果
 
     // 添加搜索方法
     void setupSearchDialog();
     void performSearch();
+    int currentSearchColumn() const;
+    void searchModel(int column, const QString &searchText, bool fetchUnloaded = true);
+    void fetchSearchMatches(int column, const QString &searchText);
+    void performServerSearch(bool loadMore);
+    void leaveServerSearch();
     void highlightSearchResult(int index);
     void findNext();
     void findPrev();
     void clearSearchHighlights();
+    void invalidateSearch();
 
     // 方法
-    bool initDatabase();
+    void initDatabase();
+    void openServer();
+    DatabaseWorker *readWorker() const;
+    void reconcileCache();
+    void refreshCache(bool redraw);
+    void refreshCachePage(const QString &afterSerialNumber, bool redraw);
+    void finishCacheRefresh(bool redraw);
+    void saveCacheRefresh(bool redraw);
+    // saveCursor 为 false 时只写入数据（本工作站刚提交的修改），不移动缓存的同步位置
+    void mirrorToCache(const ChangeSet &changes, bool saveCursor = true);
+    void startSync();
+    void onServerConnected();
+    void goOffline();
+    void tryReconnect();
+    void checkServer();
+    void updateOfflineStatus();
+    // done(错误信息, 服务器上修改后的主行)；写入离线日志时主行为空，由调用方在本地更新
+    void submitOperation(const PendingOperation &operation,
+                         std::function<void(const QString &, const SerialRecord &)> done);
+    bool queueOperation(const PendingOperation &operation, QString &error);
+    void replayJournal();
+    void refreshSerial(const QString &serialNumber);
+    void updateSerialRow(const QString &serialNumber, const SerialRecord &updated, int remainingDelta);
+    void setBusy(bool busy);
+    void syncChanges();
+    void applyChanges(const ChangeSet &changes);
     void loadSerialNumbers();
-    void loadActivationInfo();
+    void loadMoreSerialNumbers(const QString &afterSerialNumber);
+    void loadActivations(const QString &serialNumber);
+    void downloadBlob(BlobStore::Kind kind);
     bool verifyPassword();
-    void updateSerialNumberInDatabase(const QModelIndex &index);
-    void updateActivationInfoInDatabase(const QString &serialNumber, const QModelIndex &index);
+    void updateSerialNumberInDatabase(const QModelIndex &index, const QString &serialNumber,
+                                      const QString &value);
     void updateChildItemInDatabase(const QModelIndex &index);
     void deleteChildItem(const QModelIndex &index);
     void setupUI();
@@ -128,9 +200,19 @@ private:
     void setupSerialTable();
 
     //Excel数据
-    CSVData parseCSVFile(const QString &filePath);
-    bool addDataToSystem(const CSVData &data);
-    bool isSerialNumberExists(const QString &serialNumber);
+    struct ImportItem {
+        QString fileName;
+        CSVData data;
+    };
+    QPushButton *importButton;
+    QPushButton *importDirButton;
+    QPushButton *exportButton;
+    void importCsvFiles(const QStringList &filePaths);
+    void setImporting(bool importing);
+    void addDataToSystem(const QVector<ImportItem> &plan, QStringList summary);
+    void showImportSummary(const QStringList &summary, int imported, int failed);
+    // 在界面和数据库中查找已存在的序列号
+    void findExistingSerials(const QStringList &serialNumbers, std::function<void(const QSet<QString> &)> done);
 };
 
 #endif // MAINWINDOW_H
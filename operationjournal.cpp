@@ -0,0 +1,471 @@
+#include "operationjournal.h"
+#include "activationstore.h"
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSet>
+#include <QDebug>
+
+PendingOperation PendingOperation::addSerial(const SerialRecord &record, const QString &licensePath,
+                                             const QString &kyinfoPath)
+{
+    PendingOperation operation;
+    operation.type = AddSerial;
+    operation.serialNumber = record.serialNumber;
+    operation.args["totalActivations"] = record.totalActivations;
+    operation.args["remainingActivations"] = record.remainingActivations;
+    operation.args["platform"] = record.platform;
+    operation.args["verificationCode"] = record.verificationCode;
+    operation.args["bindWechat"] = record.bindWechat;
+    operation.args["bindPerson"] = record.bindPerson;
+    operation.args["licensePath"] = licensePath;
+    operation.args["kyinfoPath"] = kyinfoPath;
+    return operation;
+}
+
+PendingOperation PendingOperation::updateSerial(const QString &serialNumber, const QString &columnName,
+                                                const QVariant &value, int version)
+{
+    PendingOperation operation;
+    operation.type = UpdateSerial;
+    operation.serialNumber = serialNumber;
+    operation.args["column"] = columnName;
+    operation.args["value"] = value;
+    operation.args["version"] = version;
+    return operation;
+}
+
+PendingOperation PendingOperation::deleteSerial(const QString &serialNumber)
+{
+    PendingOperation operation;
+    operation.type = DeleteSerial;
+    operation.serialNumber = serialNumber;
+    return operation;
+}
+
+PendingOperation PendingOperation::addActivation(const QString &serialNumber, const ActivationRecord &record)
+{
+    PendingOperation operation;
+    operation.type = AddActivation;
+    operation.serialNumber = serialNumber;
+    operation.args["activationCode"] = record.activationCode;
+    operation.args["projectNumber"] = record.projectNumber;
+    operation.args["chassisNumber"] = record.chassisNumber;
+    return operation;
+}
+
+PendingOperation PendingOperation::updateActivation(const QString &serialNumber, const QString &activationCode,
+                                                    const QString &columnName, const QVariant &value)
+{
+    PendingOperation operation;
+    operation.type = UpdateActivation;
+    operation.serialNumber = serialNumber;
+    operation.args["activationCode"] = activationCode;
+    operation.args["column"] = columnName;
+    operation.args["value"] = value;
+    return operation;
+}
+
+PendingOperation PendingOperation::deleteActivation(const QString &serialNumber, const QString &activationCode)
+{
+    PendingOperation operation;
+    operation.type = DeleteActivation;
+    operation.serialNumber = serialNumber;
+    operation.args["activationCode"] = activationCode;
+    return operation;
+}
+
+PendingOperation PendingOperation::importCsv(const CSVData &data)
+{
+    PendingOperation operation;
+    operation.type = ImportCsv;
+    operation.serialNumber = data.serialNumber;
+    operation.args["totalActivations"] = data.totalActivations;
+    operation.args["remainingActivations"] = data.remainingActivations;
+    QVariantList codes;
+    codes.reserve(data.activationCodes.size());
+    for (const auto &codePair : data.activationCodes) {
+        codes.append(QVariant(QVariantList() << codePair.first << codePair.second));
+    }
+    operation.args["codes"] = codes;
+    return operation;
+}
+
+QString PendingOperation::description() const
+{
+    switch (type) {
+    case AddSerial:
+        return "添加序列号 " + serialNumber;
+    case UpdateSerial:
+        return QString("修改序列号 %1 的 %2").arg(serialNumber, args.value("column").toString());
+    case DeleteSerial:
+        return "删除序列号 " + serialNumber;
+    case AddActivation:
+        return QString("为序列号 %1 添加激活码 %2").arg(serialNumber, args.value("activationCode").toString());
+    case UpdateActivation:
+        return QString("修改序列号 %1 激活码 %2 的 %3")
+                .arg(serialNumber, args.value("activationCode").toString(), args.value("column").toString());
+    case DeleteActivation:
+        return QString("删除序列号 %1 的激活码 %2").arg(serialNumber, args.value("activationCode").toString());
+    case ImportCsv:
+        return "导入序列号 " + serialNumber;
+    }
+    return serialNumber;
+}
+
+OperationJournal::OperationJournal(const QString &filePath)
+    : path(filePath),
+      fileDir(QFileInfo(filePath).absolutePath() + "/pending_files"),
+      nextId(1),
+      removedCount(0)
+{
+}
+
+bool OperationJournal::load()
+{
+    error.clear();
+    operations.clear();
+    removedCount = 0;
+
+    QFile file(path);
+    if (!file.exists()) {
+        return true;
+    }
+    if (!file.open(QIODevice::ReadOnly)) {
+        return fail("无法读取操作日志: " + file.errorString());
+    }
+    const QByteArray content = file.readAll();
+    file.close();
+
+    // 旧版本整体保存为一个 JSON 数组，读入后改写为逐行格式
+    if (content.trimmed().startsWith('[')) {
+        QJsonParseError parseError;
+        const QJsonDocument document = QJsonDocument::fromJson(content, &parseError);
+        if (parseError.error != QJsonParseError::NoError) {
+            return fail("操作日志格式错误: " + parseError.errorString());
+        }
+        for (const QJsonValue &value : document.array()) {
+            operations.append(fromJson(value.toObject()));
+            nextId = qMax(nextId, operations.last().id + 1);
+        }
+        if (!compact()) {
+            return false;
+        }
+    } else {
+        // 每行一条记录：操作本身，或 {"done": id} 表示该操作已提交
+        QSet<qint64> done;
+        bool truncated = false;
+        const QList<QByteArray> lines = content.split('\n');
+        for (int i = 0; i < lines.size(); ++i) {
+            if (lines.at(i).trimmed().isEmpty()) {
+                continue;
+            }
+            QJsonParseError parseError;
+            const QJsonDocument document = QJsonDocument::fromJson(lines.at(i), &parseError);
+            if (parseError.error != QJsonParseError::NoError || !document.isObject()) {
+                // 写到一半时程序退出，最后一行可能不完整，这条记录没有写入成功
+                if (i >= lines.size() - 2) {
+                    qDebug() << "忽略操作日志末尾不完整的记录";
+                    truncated = true;
+                    continue;
+                }
+                return fail(QString("操作日志第 %1 行格式错误: %2").arg(i + 1).arg(parseError.errorString()));
+            }
+            const QJsonObject object = document.object();
+            if (object.contains("done")) {
+                done.insert(qint64(object.value("done").toDouble()));
+                ++removedCount;
+                continue;
+            }
+            operations.append(fromJson(object));
+            nextId = qMax(nextId, operations.last().id + 1);
+        }
+        for (int i = operations.size() - 1; i >= 0; --i) {
+            if (done.contains(operations.at(i).id)) {
+                operations.remove(i);
+            }
+        }
+        // 去掉不完整的一行，之后追加的记录才能从新的一行开始
+        if (truncated && !compact()) {
+            return false;
+        }
+    }
+    if (!operations.isEmpty()) {
+        qDebug() << "操作日志中有" << operations.size() << "项未提交的修改";
+    }
+    return true;
+}
+
+bool OperationJournal::append(PendingOperation operation)
+{
+    error.clear();
+    operation.id = nextId++;
+
+    // 原文件之后可能被移动或修改，提交前一直使用副本
+    if (operation.type == PendingOperation::AddSerial) {
+        for (const QString &key : {QStringLiteral("licensePath"), QStringLiteral("kyinfoPath")}) {
+            const QString sourcePath = operation.args.value(key).toString();
+            if (sourcePath.isEmpty()) {
+                continue;
+            }
+            const QString copy = copyFile(operation.id, key, sourcePath);
+            if (copy.isEmpty()) {
+                removeFiles(operation);
+                return false;
+            }
+            operation.args[key] = copy;
+        }
+    }
+
+    if (!appendLine(toJson(operation))) {
+        removeFiles(operation);
+        return false;
+    }
+    operations.append(operation);
+    return true;
+}
+
+bool OperationJournal::removeFirst()
+{
+    error.clear();
+    if (operations.isEmpty()) {
+        return true;
+    }
+
+    // 只追加一行提交记录；日志清空或提交记录积累较多时才整体重写
+    const PendingOperation operation = operations.first();
+    QJsonObject done;
+    done["done"] = double(operation.id);
+    if (!appendLine(done)) {
+        return false;
+    }
+    operations.removeFirst();
+    ++removedCount;
+    removeFiles(operation);
+    if (operations.isEmpty() || (removedCount >= CompactThreshold && removedCount > operations.size())) {
+        return compact();
+    }
+    return true;
+}
+
+const PendingOperation &OperationJournal::first() const
+{
+    return operations.first();
+}
+
+bool OperationJournal::isEmpty() const
+{
+    return operations.isEmpty();
+}
+
+int OperationJournal::size() const
+{
+    return operations.size();
+}
+
+QString OperationJournal::lastError() const
+{
+    return error;
+}
+
+bool OperationJournal::apply(ActivationStore &store, const PendingOperation &operation, QString &error,
+                             SerialRecord &updated)
+{
+    const QVariantMap &args = operation.args;
+    bool ok = false;
+
+    switch (operation.type) {
+    case PendingOperation::AddSerial: {
+        SerialRecord record;
+        record.serialNumber = operation.serialNumber;
+        record.totalActivations = args.value("totalActivations").toInt();
+        record.remainingActivations = args.value("remainingActivations").toInt();
+        record.platform = args.value("platform").toString();
+        record.verificationCode = args.value("verificationCode").toString();
+        record.bindWechat = args.value("bindWechat").toString();
+        record.bindPerson = args.value("bindPerson").toString();
+        ok = store.addSerial(record, args.value("licensePath").toString(), args.value("kyinfoPath").toString());
+        break;
+    }
+    case PendingOperation::UpdateSerial:
+        ok = store.updateSerialColumn(operation.serialNumber, args.value("column").toString(), args.value("value"),
+                                      args.value("version").toInt(), updated);
+        break;
+    case PendingOperation::DeleteSerial:
+        ok = store.deleteSerial(operation.serialNumber);
+        break;
+    case PendingOperation::AddActivation: {
+        ActivationRecord record;
+        record.activationCode = args.value("activationCode").toString();
+        record.projectNumber = args.value("projectNumber").toString();
+        record.chassisNumber = args.value("chassisNumber").toString();
+        ok = store.addActivation(operation.serialNumber, record, updated);
+        break;
+    }
+    case PendingOperation::UpdateActivation:
+        ok = store.updateActivationColumn(operation.serialNumber, args.value("activationCode").toString(),
+                                          args.value("column").toString(), args.value("value"));
+        break;
+    case PendingOperation::DeleteActivation:
+        ok = store.deleteActivation(operation.serialNumber, args.value("activationCode").toString(), updated);
+        break;
+    case PendingOperation::ImportCsv: {
+        CSVData data;
+        data.serialNumber = operation.serialNumber;
+        data.totalActivations = args.value("totalActivations").toInt();
+        data.remainingActivations = args.value("remainingActivations").toInt();
+        for (const QVariant &code : args.value("codes").toList()) {
+            const QVariantList pair = code.toList();
+            data.activationCodes.append(qMakePair(pair.value(0).toString(), pair.value(1).toString()));
+        }
+        ok = store.importCsv(data);
+        break;
+    }
+    }
+
+    error = store.lastError();
+    return ok;
+}
+
+bool OperationJournal::checkConflict(ActivationStore &store, const PendingOperation &operation, QString &reason)
+{
+    reason.clear();
+
+    QVector<SerialRecord> serials;
+    if (!store.loadSerials(QStringList() << operation.serialNumber, serials)) {
+        return false;
+    }
+    const bool exists = !serials.isEmpty();
+
+    switch (operation.type) {
+    case PendingOperation::AddSerial:
+    case PendingOperation::ImportCsv:
+        if (exists) {
+            reason = "序列号已被其他工作站添加";
+        }
+        return true;
+    case PendingOperation::UpdateSerial:
+    case PendingOperation::DeleteSerial:
+        if (!exists) {
+            reason = "序列号已被其他工作站删除";
+        }
+        return true;
+    default:
+        break;
+    }
+
+    if (!exists) {
+        reason = "序列号已被其他工作站删除";
+        return true;
+    }
+
+    // 剩余激活次数在服务器上原子加减，不会覆盖其他工作站的修改；
+    // 主行修改的版本号由 updateSerialColumn 检查
+    const QVariantMap &args = operation.args;
+    if (operation.type == PendingOperation::AddActivation) {
+        return true;
+    }
+    QVector<ActivationRecord> activations;
+    if (!store.loadActivations(operation.serialNumber, activations)) {
+        return false;
+    }
+    const QString activationCode = args.value("activationCode").toString();
+    for (const ActivationRecord &activation : activations) {
+        if (activation.activationCode == activationCode) {
+            return true;
+        }
+    }
+    reason = "激活码已被其他工作站修改或删除";
+    return true;
+}
+
+QJsonObject OperationJournal::toJson(const PendingOperation &operation)
+{
+    QJsonObject object;
+    object["id"] = double(operation.id);
+    object["type"] = int(operation.type);
+    object["serialNumber"] = operation.serialNumber;
+    object["args"] = QJsonObject::fromVariantMap(operation.args);
+    return object;
+}
+
+PendingOperation OperationJournal::fromJson(const QJsonObject &object)
+{
+    PendingOperation operation;
+    operation.id = qint64(object.value("id").toDouble());
+    operation.type = PendingOperation::Type(object.value("type").toInt());
+    operation.serialNumber = object.value("serialNumber").toString();
+    operation.args = object.value("args").toObject().toVariantMap();
+    return operation;
+}
+
+bool OperationJournal::appendLine(const QJsonObject &object)
+{
+    QDir().mkpath(QFileInfo(path).absolutePath());
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Append)) {
+        return fail("无法保存操作日志: " + file.errorString());
+    }
+    const QByteArray line = QJsonDocument(object).toJson(QJsonDocument::Compact) + '\n';
+    if (file.write(line) != line.size() || !file.flush()) {
+        return fail("无法保存操作日志: " + file.errorString());
+    }
+    return true;
+}
+
+bool OperationJournal::compact()
+{
+    removedCount = 0;
+    if (operations.isEmpty()) {
+        if (QFile::exists(path) && !QFile::remove(path)) {
+            return fail("无法清理操作日志: " + path);
+        }
+        return true;
+    }
+
+    // 先写临时文件再替换，中途退出时原文件保持完整
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return fail("无法保存操作日志: " + file.errorString());
+    }
+    for (const PendingOperation &operation : operations) {
+        file.write(QJsonDocument(toJson(operation)).toJson(QJsonDocument::Compact) + '\n');
+    }
+    if (!file.commit()) {
+        return fail("无法保存操作日志: " + file.errorString());
+    }
+    return true;
+}
+
+QString OperationJournal::copyFile(qint64 id, const QString &name, const QString &sourcePath)
+{
+    QDir().mkpath(fileDir);
+    const QString target = QString("%1/%2_%3").arg(fileDir).arg(id).arg(name);
+    QFile::remove(target);
+    if (!QFile::copy(sourcePath, target)) {
+        fail("无法保存文件副本: " + sourcePath);
+        return QString();
+    }
+    return target;
+}
+
+void OperationJournal::removeFiles(const PendingOperation &operation)
+{
+    for (const QString &key : {QStringLiteral("licensePath"), QStringLiteral("kyinfoPath")}) {
+        const QString filePath = operation.args.value(key).toString();
+        if (filePath.startsWith(fileDir)) {
+            QFile::remove(filePath);
+        }
+    }
+}
+
+bool OperationJournal::fail(const QString &message)
+{
+    error = message;
+    qDebug() << message;
+    return false;
+}
@@ -0,0 +1,90 @@
+#ifndef OPERATIONJOURNAL_H
+#define OPERATIONJOURNAL_H
+
+#include <QString>
+#include <QVariantMap>
+#include <QVector>
+#include "serialrecord.h"
+
+class ActivationStore;
+class QJsonObject;
+
+// 一次修改操作，离线时写入操作日志，恢复连接后按顺序提交
+struct PendingOperation {
+    enum Type {
+        AddSerial,
+        UpdateSerial,
+        DeleteSerial,
+        AddActivation,
+        UpdateActivation,
+        DeleteActivation,
+        ImportCsv
+    };
+
+    qint64 id = 0;
+    Type type = AddSerial;
+    QString serialNumber;
+    QVariantMap args;
+
+    static PendingOperation addSerial(const SerialRecord &record, const QString &licensePath,
+                                      const QString &kyinfoPath);
+    static PendingOperation updateSerial(const QString &serialNumber, const QString &columnName,
+                                         const QVariant &value, int version);
+    static PendingOperation deleteSerial(const QString &serialNumber);
+    static PendingOperation addActivation(const QString &serialNumber, const ActivationRecord &record);
+    static PendingOperation updateActivation(const QString &serialNumber, const QString &activationCode,
+                                             const QString &columnName, const QVariant &value);
+    static PendingOperation deleteActivation(const QString &serialNumber, const QString &activationCode);
+    static PendingOperation importCsv(const CSVData &data);
+
+    // 冲突提示中显示的说明
+    QString description() const;
+};
+
+// 离线操作日志
+// 保存在本地文件中，每行一条 JSON 记录，程序退出后仍然保留：添加操作追加一行，
+// 提交后追加一行提交记录，只在日志清空或提交记录积累较多时整体重写（先写临时文件再替换）；
+// 添加序列号时选择的 LICENSE/.kyinfo 文件复制到日志目录，提交后删除
+class OperationJournal
+{
+public:
+    explicit OperationJournal(const QString &filePath);
+
+    bool load();
+    bool append(PendingOperation operation);
+    bool removeFirst();
+    const PendingOperation &first() const;
+    bool isEmpty() const;
+    int size() const;
+
+    QString lastError() const;
+
+    // 在服务器上执行一次操作；修改主行的操作成功后 updated 为服务器上修改后的主行
+    static bool apply(ActivationStore &store, const PendingOperation &operation, QString &error,
+                      SerialRecord &updated);
+
+    // 提交日志中的操作前检查服务器上的数据是否已被其他工作站改动，
+    // 有冲突时 reason 为说明，操作不再提交
+    static bool checkConflict(ActivationStore &store, const PendingOperation &operation, QString &reason);
+
+private:
+    QString path;
+    QString fileDir;  // 随操作保存的文件
+    // 文件中的提交记录达到这个数量且多于未提交的操作时整体重写
+    static const int CompactThreshold = 1000;
+
+    QVector<PendingOperation> operations;
+    qint64 nextId;
+    int removedCount;  // 文件中已提交、尚未重写掉的操作数
+    QString error;
+
+    static QJsonObject toJson(const PendingOperation &operation);
+    static PendingOperation fromJson(const QJsonObject &object);
+    bool appendLine(const QJsonObject &object);
+    bool compact();
+    QString copyFile(qint64 id, const QString &name, const QString &sourcePath);
+    void removeFiles(const PendingOperation &operation);
+    bool fail(const QString &message);
+};
+
+#endif // OPERATIONJOURNAL_H
@@ -0,0 +1,250 @@
+#include "querymonitor.h"
+#include <QDateTime>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QRegularExpression>
+#include <QSqlError>
+#include <QDebug>
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// 每条语句保留最近的耗时样本数，分位数按这些样本计算
+const int MaxSamples = 1024;
+
+// 慢查询日志中语句的最大长度
+const int MaxLoggedSql = 1000;
+
+struct Entry {
+    QString sql;
+    qint64 executions = 0;
+    qint64 errors = 0;
+    qint64 totalNs = 0;
+    qint64 maxNs = 0;
+    QVector<qint64> samples;
+    int next = 0;  // samples 写满后下一个覆盖的位置
+    const char *lastOperation = nullptr;
+};
+
+struct State {
+    QMutex mutex;
+    QHash<QString, Entry *> entries;   // 归一化后的语句
+    QHash<QString, Entry *> byRawSql;  // 原始语句，避免每次执行都归一化
+    QString logPath;
+    qint64 thresholdNs = -1;
+    qint64 maxBytes = 0;
+    int keepFiles = 0;
+
+    ~State()
+    {
+        qDeleteAll(entries);
+    }
+};
+
+State &state()
+{
+    static State instance;
+    return instance;
+}
+
+thread_local const char *currentOperation = nullptr;
+
+// 参数个数不同的 IN 列表和多行 VALUES 归为同一条语句
+QString normalize(const QString &sql)
+{
+    static const QRegularExpression placeholders("\\?(\\s*,\\s*\\?)+");
+    static const QRegularExpression rows("\\)(\\s*,\\s*\\([^()]*\\))+");
+    QString normalized = sql.simplified();
+    normalized.replace(placeholders, "?, ...");
+    normalized.replace(rows, "), ...");
+    return normalized;
+}
+
+double percentile(const QVector<qint64> &sorted, double p)
+{
+    if (sorted.isEmpty()) {
+        return 0;
+    }
+    const int index = qBound(0, int(std::ceil(p * sorted.size())) - 1, sorted.size() - 1);
+    return sorted.at(index) / 1e6;
+}
+
+// 调用方持有锁
+void rotateLog(const State &s)
+{
+    if (QFileInfo(s.logPath).size() < s.maxBytes) {
+        return;
+    }
+    QFile::remove(QString("%1.%2").arg(s.logPath).arg(s.keepFiles));
+    for (int i = s.keepFiles - 1; i >= 1; --i) {
+        QFile::rename(QString("%1.%2").arg(s.logPath).arg(i), QString("%1.%2").arg(s.logPath).arg(i + 1));
+    }
+    if (s.keepFiles > 0) {
+        QFile::rename(s.logPath, s.logPath + ".1");
+    } else {
+        QFile::remove(s.logPath);
+    }
+}
+
+// 调用方持有锁
+void writeSlowLog(const State &s, const QString &sql, const char *operation, int binds, qint64 rows,
+                  qint64 nsecs, const QString &error)
+{
+    rotateLog(s);
+    QFile file(s.logPath);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Append)) {
+        return;
+    }
+    // 时间、耗时、操作、参数个数、行数（-1 表示驱动未提供）、错误、语句，以制表符分隔
+    QString line = QString("%1\t%2 ms\t%3\tbinds=%4\trows=%5\t%6\t%7\n")
+            .arg(QDateTime::currentDateTime().toString("yyyy-MM-dd hh:mm:ss.zzz"))
+            .arg(nsecs / 1e6, 0, 'f', 1)
+            .arg(QString::fromLatin1(operation ? operation : "-"))
+            .arg(binds)
+            .arg(rows)
+            .arg(error.isEmpty() ? QString("-") : error.simplified())
+            .arg(sql.simplified().left(MaxLoggedSql));
+    file.write(line.toUtf8());
+}
+
+} // namespace
+
+QueryMonitor::Operation::Operation(const char *name)
+    : previous(currentOperation)
+{
+    currentOperation = name;
+}
+
+QueryMonitor::Operation::~Operation()
+{
+    currentOperation = previous;
+}
+
+bool QueryMonitor::exec(QSqlQuery &query)
+{
+    QElapsedTimer timer;
+    timer.start();
+    const bool ok = query.exec();
+    return record(query, query.lastQuery(), ok, timer.nsecsElapsed());
+}
+
+bool QueryMonitor::exec(QSqlQuery &query, const QString &sql)
+{
+    QElapsedTimer timer;
+    timer.start();
+    const bool ok = query.exec(sql);
+    return record(query, sql, ok, timer.nsecsElapsed());
+}
+
+void QueryMonitor::configure(const QString &filePath, int thresholdMs, qint64 maxBytes, int keepFiles)
+{
+    State &s = state();
+    QMutexLocker locker(&s.mutex);
+    s.logPath = thresholdMs >= 0 ? filePath : QString();
+    s.thresholdNs = qint64(thresholdMs) * 1000000;
+    s.maxBytes = maxBytes;
+    s.keepFiles = keepFiles;
+    if (!s.logPath.isEmpty()) {
+        QDir().mkpath(QFileInfo(s.logPath).absolutePath());
+    }
+}
+
+QVector<QueryMonitor::Summary> QueryMonitor::summaries()
+{
+    QVector<Summary> result;
+    State &s = state();
+    QMutexLocker locker(&s.mutex);
+    result.reserve(s.entries.size());
+    for (const Entry *entry : s.entries) {
+        QVector<qint64> sorted = entry->samples;
+        std::sort(sorted.begin(), sorted.end());
+
+        Summary summary;
+        summary.sql = entry->sql;
+        summary.executions = entry->executions;
+        summary.errors = entry->errors;
+        summary.p50Ms = percentile(sorted, 0.50);
+        summary.p95Ms = percentile(sorted, 0.95);
+        summary.p99Ms = percentile(sorted, 0.99);
+        summary.maxMs = entry->maxNs / 1e6;
+        summary.totalMs = entry->totalNs / 1e6;
+        summary.lastOperation = QString::fromLatin1(entry->lastOperation ? entry->lastOperation : "");
+        result.append(summary);
+    }
+    locker.unlock();
+
+    std::sort(result.begin(), result.end(), [](const Summary &a, const Summary &b) {
+        return a.totalMs > b.totalMs;
+    });
+    return result;
+}
+
+void QueryMonitor::reset()
+{
+    State &s = state();
+    QMutexLocker locker(&s.mutex);
+    qDeleteAll(s.entries);
+    s.entries.clear();
+    s.byRawSql.clear();
+}
+
+void QueryMonitor::logSummaries()
+{
+    for (const Summary &summary : summaries()) {
+        qDebug().noquote() << QString("[SQL] %1 次，失败 %2 次，p50 %3 ms，p95 %4 ms，p99 %5 ms，最长 %6 ms: %7")
+                              .arg(summary.executions)
+                              .arg(summary.errors)
+                              .arg(summary.p50Ms, 0, 'f', 2)
+                              .arg(summary.p95Ms, 0, 'f', 2)
+                              .arg(summary.p99Ms, 0, 'f', 2)
+                              .arg(summary.maxMs, 0, 'f', 2)
+                              .arg(summary.sql);
+    }
+}
+
+bool QueryMonitor::record(QSqlQuery &query, const QString &sql, bool ok, qint64 nsecs)
+{
+    // SELECT 的行数只有驱动缓冲了结果时才知道（SQLite 只进游标为 -1）
+    const int binds = query.boundValues().size();
+    const qint64 rows = !ok ? -1 : (query.isSelect() ? query.size() : query.numRowsAffected());
+    const char *operation = currentOperation;
+
+    State &s = state();
+    QMutexLocker locker(&s.mutex);
+    Entry *entry = s.byRawSql.value(sql);
+    if (!entry) {
+        const QString key = normalize(sql);
+        entry = s.entries.value(key);
+        if (!entry) {
+            entry = new Entry;
+            entry->sql = key;
+            s.entries.insert(key, entry);
+        }
+        s.byRawSql.insert(sql, entry);
+    }
+
+    ++entry->executions;
+    if (!ok) {
+        ++entry->errors;
+    }
+    entry->totalNs += nsecs;
+    entry->maxNs = qMax(entry->maxNs, nsecs);
+    if (entry->samples.size() < MaxSamples) {
+        entry->samples.append(nsecs);
+    } else {
+        entry->samples[entry->next] = nsecs;
+        entry->next = (entry->next + 1) % MaxSamples;
+    }
+    entry->lastOperation = operation;
+
+    if (!s.logPath.isEmpty() && (nsecs >= s.thresholdNs || !ok)) {
+        writeSlowLog(s, sql, operation, binds, rows, nsecs, ok ? QString() : query.lastError().text());
+    }
+    return ok;
+}
@@ -0,0 +1,58 @@
+#ifndef QUERYMONITOR_H
+#define QUERYMONITOR_H
+
+#include <QSqlQuery>
+#include <QString>
+#include <QVector>
+
+// SQL 执行监控
+// 数据库代码中的语句都经 QueryMonitor::exec 执行，记录语句、绑定参数个数、行数、耗时
+// 和当前操作（见 Operation）；按语句汇总最近的耗时分布，超过阈值的写入慢查询日志。
+// 各工作线程共用一份统计，内部加锁
+class QueryMonitor
+{
+public:
+    // 一条语句的汇总；IN (?, ?, ...) 和多行 VALUES 按参数个数不同的语句合并为一条
+    struct Summary {
+        QString sql;
+        qint64 executions = 0;
+        qint64 errors = 0;
+        double p50Ms = 0;
+        double p95Ms = 0;
+        double p99Ms = 0;
+        double maxMs = 0;
+        double totalMs = 0;
+        QString lastOperation;
+    };
+
+    // 在作用域内把当前线程执行的语句归到 name 操作下，结束时恢复外层的操作
+    class Operation
+    {
+    public:
+        explicit Operation(const char *name);
+        ~Operation();
+
+    private:
+        Q_DISABLE_COPY(Operation)
+        const char *previous;
+    };
+
+    // 执行已 prepare 的语句
+    static bool exec(QSqlQuery &query);
+    // 直接执行 sql
+    static bool exec(QSqlQuery &query, const QString &sql);
+
+    // 慢查询日志：耗时不低于 thresholdMs 的语句和执行失败的语句追加到 filePath，超过 maxBytes 时轮转，保留 keepFiles 个旧文件；
+    // filePath 为空或 thresholdMs 小于 0 时不写日志
+    static void configure(const QString &filePath, int thresholdMs, qint64 maxBytes = 1024 * 1024, int keepFiles = 3);
+
+    // 按总耗时从多到少排列
+    static QVector<Summary> summaries();
+    static void reset();
+    static void logSummaries();
+
+private:
+    static bool record(QSqlQuery &query, const QString &sql, bool ok, qint64 nsecs);
+};
+
+#endif // QUERYMONITOR_H
@@ -0,0 +1,356 @@
+#include "schemamigrations.h"
+#include "querymonitor.h"
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QSqlRecord>
+#include <QDebug>
+
+// 高频语句：界面上修改/删除激活码、展开主行、增减剩余次数和增量同步
+struct HotQuery {
+    const char *name;
+    const char *sql;
+    int parameters;
+};
+
+static const HotQuery HotQueries[] = {
+    {"修改激活信息", "UPDATE activation_info SET project_number = ? WHERE serial_number = ? AND activation_code = ?", 3},
+    {"删除激活信息", "DELETE FROM activation_info WHERE serial_number = ? AND activation_code = ?", 2},
+    {"展开主行", "SELECT serial_number, activation_code, project_number, chassis_number "
+                 "FROM activation_info WHERE serial_number IN (?) ORDER BY id", 1},
+    {"按激活码查找", "SELECT serial_number FROM activation_info WHERE activation_code = ?", 1},
+    {"扣减剩余次数", "UPDATE serial_numbers SET remaining_activations = remaining_activations - 1, "
+                     "version = version + 1 WHERE serial_number = ? AND remaining_activations > 0", 1},
+    {"增量同步", "SELECT id, serial_number, client_id FROM change_log WHERE id > ? ORDER BY id LIMIT 1000", 1}
+};
+
+SchemaMigrations::SchemaMigrations(const QSqlDatabase &db, bool localCache)
+    : db(db),
+      localCache(localCache)
+{
+    // 只能在末尾追加新步骤，已发布的步骤不能改版本号或调整顺序
+    steps = {
+        {1, "activation_info 增加 (serial_number, activation_code) 复合索引", false,
+         &SchemaMigrations::addSerialCodeIndex},
+        {2, "activation_info 外键改为随序列号级联删除/更新", true,
+         &SchemaMigrations::addCascadeForeignKey},
+        {3, "activation_code 唯一约束", true,
+         &SchemaMigrations::addUniqueActivationCode}
+    };
+}
+
+bool SchemaMigrations::run()
+{
+    error.clear();
+    if (!initVersionTable()) {
+        return false;
+    }
+
+    const int current = currentVersion();
+    if (current < 0) {
+        return false;
+    }
+    for (const Step &step : steps) {
+        if (step.version <= current) {
+            continue;
+        }
+        if (step.constraint && localCache) {
+            qDebug() << "本地缓存跳过结构迁移" << step.version << step.description;
+        } else {
+            qDebug() << "执行结构迁移" << step.version << step.description;
+            if (!(this->*step.apply)()) {
+                return fail(QString("结构迁移 %1（%2）失败: %3").arg(step.version).arg(step.description, error));
+            }
+        }
+        if (!recordVersion(step)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int SchemaMigrations::currentVersion()
+{
+    QSqlQuery query(db);
+    if (!QueryMonitor::exec(query, "SELECT MAX(version) FROM schema_version") || !query.next()) {
+        fail("读取结构版本失败: " + query.lastError().text());
+        return -1;
+    }
+    return query.value(0).toInt();
+}
+
+int SchemaMigrations::latestVersion() const
+{
+    return steps.isEmpty() ? 0 : steps.last().version;
+}
+
+QStringList SchemaMigrations::explainHotQueries(QStringList *fullScans)
+{
+    QStringList report;
+    for (const HotQuery &hotQuery : HotQueries) {
+        bool fullScan = false;
+        const QStringList plan = explain(hotQuery.sql, hotQuery.parameters, fullScan);
+        report.append(QString("%1: %2").arg(QString::fromUtf8(hotQuery.name), plan.join("; ")));
+        if (fullScan && fullScans) {
+            fullScans->append(QString::fromUtf8(hotQuery.name));
+        }
+    }
+    return report;
+}
+
+QString SchemaMigrations::lastError() const
+{
+    return error;
+}
+
+bool SchemaMigrations::isSqlite() const
+{
+    return db.driverName() == "QSQLITE";
+}
+
+bool SchemaMigrations::initVersionTable()
+{
+    QSqlQuery query(db);
+    if (!QueryMonitor::exec(query, isSqlite()
+                                   ? "CREATE TABLE IF NOT EXISTS schema_version ("
+                                     "version INTEGER PRIMARY KEY, "
+                                     "description TEXT, "
+                                     "applied_at TIMESTAMP DEFAULT CURRENT_TIMESTAMP)"
+                                   : "CREATE TABLE IF NOT EXISTS schema_version ("
+                                     "version INT PRIMARY KEY, "
+                                     "description VARCHAR(200), "
+                                     "applied_at TIMESTAMP DEFAULT CURRENT_TIMESTAMP)")) {
+        return fail("创建schema_version表失败: " + query.lastError().text());
+    }
+    return true;
+}
+
+bool SchemaMigrations::recordVersion(const Step &step)
+{
+    // 其他工作站可能同时完成了同一步
+    QSqlQuery query(db);
+    query.prepare(isSqlite()
+                  ? "INSERT OR IGNORE INTO schema_version (version, description) VALUES (?, ?)"
+                  : "INSERT IGNORE INTO schema_version (version, description) VALUES (?, ?)");
+    query.addBindValue(step.version);
+    query.addBindValue(step.description);
+    if (!QueryMonitor::exec(query)) {
+        return fail("记录结构版本失败: " + query.lastError().text());
+    }
+    return true;
+}
+
+bool SchemaMigrations::hasIndex(const QString &table, const QString &indexName, bool &exists)
+{
+    QSqlQuery query(db);
+    if (isSqlite()) {
+        query.prepare("SELECT COUNT(*) FROM sqlite_master WHERE type = 'index' AND tbl_name = ? AND name = ?");
+    } else {
+        query.prepare("SELECT COUNT(*) FROM information_schema.statistics "
+                      "WHERE table_schema = DATABASE() AND table_name = ? AND index_name = ?");
+    }
+    query.addBindValue(table);
+    query.addBindValue(indexName);
+    if (!QueryMonitor::exec(query) || !query.next()) {
+        return fail("读取索引信息失败: " + query.lastError().text());
+    }
+    exists = query.value(0).toInt() > 0;
+    return true;
+}
+
+bool SchemaMigrations::createIndex(const QString &table, const QString &indexName, const QString &columns,
+                                   bool unique)
+{
+    bool exists = false;
+    if (!hasIndex(table, indexName, exists)) {
+        return false;
+    }
+    if (exists) {
+        return true;
+    }
+
+    QSqlQuery query(db);
+    const QString kind = unique ? "UNIQUE INDEX " : "INDEX ";
+    if (!QueryMonitor::exec(query, "CREATE " + kind + indexName + " ON " + table + " (" + columns + ")")) {
+        return fail("创建索引 " + indexName + " 失败: " + query.lastError().text());
+    }
+    return true;
+}
+
+bool SchemaMigrations::addSerialCodeIndex()
+{
+    // 修改/删除激活信息都按 (serial_number, activation_code) 定位一行
+    return createIndex("activation_info", "idx_activation_serial_code", "serial_number, activation_code", false);
+}
+
+bool SchemaMigrations::addCascadeForeignKey()
+{
+    QSqlQuery query(db);
+
+    if (isSqlite()) {
+        // SQLite 不能修改已有约束，需要重建表
+        if (!QueryMonitor::exec(query, "PRAGMA foreign_key_list(activation_info)")) {
+            return fail("读取外键失败: " + query.lastError().text());
+        }
+        while (query.next()) {
+            if (query.value(2).toString() == "serial_numbers"
+                    && query.value(6).toString().compare("CASCADE", Qt::CaseInsensitive) == 0) {
+                return true;
+            }
+        }
+        return rebuildActivationTable();
+    }
+
+    query.prepare("SELECT constraint_name, delete_rule FROM information_schema.referential_constraints "
+                  "WHERE constraint_schema = DATABASE() AND table_name = 'activation_info' "
+                  "AND referenced_table_name = 'serial_numbers'");
+    if (!QueryMonitor::exec(query)) {
+        return fail("读取外键失败: " + query.lastError().text());
+    }
+    QStringList oldKeys;
+    while (query.next()) {
+        if (query.value(1).toString().compare("CASCADE", Qt::CaseInsensitive) == 0) {
+            return true;
+        }
+        oldKeys.append(query.value(0).toString());
+    }
+
+    // 先删旧外键再加新外键；中途失败时下次启动找不到旧外键，只会执行添加
+    for (const QString &key : oldKeys) {
+        if (!QueryMonitor::exec(query, "ALTER TABLE activation_info DROP FOREIGN KEY `" + key + "`")) {
+            return fail("删除外键 " + key + " 失败: " + query.lastError().text());
+        }
+    }
+    if (!QueryMonitor::exec(query, "ALTER TABLE activation_info ADD CONSTRAINT fk_activation_serial "
+                                   "FOREIGN KEY (serial_number) REFERENCES serial_numbers(serial_number) "
+                                   "ON DELETE CASCADE ON UPDATE CASCADE")) {
+        return fail("添加外键失败（activation_info 中可能有不存在的序列号）: " + query.lastError().text());
+    }
+    return true;
+}
+
+bool SchemaMigrations::rebuildActivationTable()
+{
+    QSqlQuery query(db);
+
+    // 重建期间不能检查外键，该设置在事务中无效，必须在事务外修改
+    // 没有事务时删表和改名之间失败会丢掉 activation_info，不开始重建
+    QueryMonitor::exec(query, "PRAGMA foreign_keys = OFF");
+    if (!db.transaction()) {
+        const QString message = "重建activation_info表失败，无法开始事务: " + db.lastError().text();
+        QueryMonitor::exec(query, "PRAGMA foreign_keys = ON");
+        return fail(message);
+    }
+
+    const QStringList statements = {
+        "CREATE TABLE activation_info_new ("
+        "id INTEGER PRIMARY KEY AUTOINCREMENT, "
+        "serial_number TEXT, "
+        "activation_code TEXT, "
+        "project_number TEXT, "
+        "chassis_number TEXT, "
+        "FOREIGN KEY(serial_number) REFERENCES serial_numbers(serial_number) "
+        "ON DELETE CASCADE ON UPDATE CASCADE)",
+        "INSERT INTO activation_info_new (id, serial_number, activation_code, project_number, chassis_number) "
+        "SELECT id, serial_number, activation_code, project_number, chassis_number FROM activation_info",
+        "DROP TABLE activation_info",
+        "ALTER TABLE activation_info_new RENAME TO activation_info",
+        // 索引随旧表删除，在新表上重建
+        "CREATE INDEX IF NOT EXISTS idx_activation_serial ON activation_info(serial_number)",
+        "CREATE INDEX IF NOT EXISTS idx_activation_code ON activation_info(activation_code)",
+        "CREATE INDEX IF NOT EXISTS idx_project_number ON activation_info(project_number)",
+        "CREATE INDEX IF NOT EXISTS idx_chassis_number ON activation_info(chassis_number)",
+        "CREATE INDEX IF NOT EXISTS idx_activation_serial_code ON activation_info(serial_number, activation_code)"
+    };
+    for (const QString &sql : statements) {
+        if (!QueryMonitor::exec(query, sql)) {
+            const QString message = "重建activation_info表失败: " + query.lastError().text();
+            db.rollback();
+            QueryMonitor::exec(query, "PRAGMA foreign_keys = ON");
+            return fail(message);
+        }
+    }
+    if (!db.commit()) {
+        const QString message = "重建activation_info表失败: " + db.lastError().text();
+        db.rollback();
+        QueryMonitor::exec(query, "PRAGMA foreign_keys = ON");
+        return fail(message);
+    }
+    QueryMonitor::exec(query, "PRAGMA foreign_keys = ON");
+    return true;
+}
+
+bool SchemaMigrations::addUniqueActivationCode()
+{
+    bool exists = false;
+    if (!hasIndex("activation_info", "uq_activation_code", exists)) {
+        return false;
+    }
+    if (exists) {
+        return true;
+    }
+
+    // 已有重复激活码时不自动删除数据，列出前几个交给管理员处理，处理后下次启动再试
+    QSqlQuery query(db);
+    if (!QueryMonitor::exec(query, "SELECT activation_code, COUNT(*) FROM activation_info "
+                                   "WHERE activation_code IS NOT NULL "
+                                   "GROUP BY activation_code HAVING COUNT(*) > 1 LIMIT 5")) {
+        return fail("检查重复激活码失败: " + query.lastError().text());
+    }
+    QStringList duplicates;
+    while (query.next()) {
+        duplicates.append(QString("%1(%2)").arg(query.value(0).toString()).arg(query.value(1).toInt()));
+    }
+    if (!duplicates.isEmpty()) {
+        return fail("存在重复的激活码: " + duplicates.join(", "));
+    }
+
+    return createIndex("activation_info", "uq_activation_code", "activation_code", true);
+}
+
+QStringList SchemaMigrations::explain(const QString &sql, int parameters, bool &fullScan)
+{
+    QStringList plan;
+    fullScan = false;
+
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+    query.prepare((isSqlite() ? "EXPLAIN QUERY PLAN " : "EXPLAIN ") + sql);
+    for (int i = 0; i < parameters; ++i) {
+        query.addBindValue(QString(""));
+    }
+    if (!QueryMonitor::exec(query)) {
+        plan.append("无法获取执行计划: " + query.lastError().text());
+        return plan;
+    }
+
+    const QSqlRecord record = query.record();
+    while (query.next()) {
+        if (isSqlite()) {
+            // 如 "SEARCH activation_info USING INDEX idx_activation_serial_code (serial_number=? AND activation_code=?)"
+            const QString detail = query.value(3).toString();
+            if (detail.startsWith("SCAN") && !detail.contains("INDEX")) {
+                fullScan = true;
+            }
+            plan.append(detail);
+        } else {
+            // type 为 ALL 表示全表扫描
+            const QString table = query.value(record.indexOf("table")).toString();
+            const QString type = query.value(record.indexOf("type")).toString();
+            const QString key = query.value(record.indexOf("key")).toString();
+            if (type == "ALL") {
+                fullScan = true;
+            }
+            plan.append(QString("%1 type=%2 key=%3 rows=%4")
+                        .arg(table, type, key.isEmpty() ? "-" : key,
+                             query.value(record.indexOf("rows")).toString()));
+        }
+    }
+    return plan;
+}
+
+bool SchemaMigrations::fail(const QString &message)
+{
+    error = message;
+    qDebug() << message;
+    return false;
+}
@@ -0,0 +1,57 @@
+#ifndef SCHEMAMIGRATIONS_H
+#define SCHEMAMIGRATIONS_H
+
+#include <QSqlDatabase>
+#include <QStringList>
+#include <QVector>
+
+// 数据库结构迁移
+// 每一步有递增的版本号，完成后记录在 schema_version 表中，启动时只执行未记录的步骤；
+// 各步骤执行前也检查是否已经完成，中途失败后重跑或多个工作站同时启动都不会出错
+class SchemaMigrations
+{
+public:
+    // localCache 为 true 时跳过约束类步骤：本地缓存只是服务器数据的镜像，由服务器保证约束
+    SchemaMigrations(const QSqlDatabase &db, bool localCache);
+
+    // 执行未完成的步骤；某一步失败时停在该步，之后的步骤下次启动再试
+    bool run();
+    int currentVersion();
+    int latestVersion() const;
+
+    // 高频语句的执行计划，每条语句一段说明；出现全表扫描时 fullScans 中记录对应语句
+    QStringList explainHotQueries(QStringList *fullScans = nullptr);
+
+    QString lastError() const;
+
+private:
+    struct Step {
+        int version;
+        QString description;
+        bool constraint;  // 约束类步骤，本地缓存不执行
+        bool (SchemaMigrations::*apply)();
+    };
+
+    QSqlDatabase db;
+    bool localCache;
+    QVector<Step> steps;
+    QString error;
+
+    bool isSqlite() const;
+    bool initVersionTable();
+    bool recordVersion(const Step &step);
+    bool hasIndex(const QString &table, const QString &indexName, bool &exists);
+    bool createIndex(const QString &table, const QString &indexName, const QString &columns, bool unique);
+
+    // 迁移步骤
+    bool addSerialCodeIndex();
+    bool addCascadeForeignKey();
+    bool addUniqueActivationCode();
+
+    bool rebuildActivationTable();
+    QStringList explain(const QString &sql, int parameters, bool &fullScan);
+
+    bool fail(const QString &message);
+};
+
+#endif // SCHEMAMIGRATIONS_H
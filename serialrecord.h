@@ -0,0 +1,40 @@
+#ifndef SERIALRECORD_H
+#define SERIALRECORD_H
+
+#include <QString>
+#include <QVector>
+#include <QPair>
+
+// 激活信息（activation_info 表的一行）
+struct ActivationRecord {
+    QString activationCode;//激活码
+    QString projectNumber;//项目号
+    QString chassisNumber;//机箱序列号
+};
+
+// 序列号（serial_numbers 表的一行，不含文件内容）
+struct SerialRecord {
+    QString serialNumber;//序列号
+    int totalActivations = 0;//总激活次数
+    int remainingActivations = 0;//剩余激活次数
+    QString platform;//硬件平台
+    QString verificationCode;//验证码
+    qint64 licenseSize = 0;//LICENSE文件大小
+    qint64 kyinfoSize = 0;//.kyinfo文件大小
+    QString bindWechat;//绑定微信
+    QString bindPerson;//绑定人
+    int activationCount = 0;//激活信息条数（子行按需加载前据此显示展开箭头）
+    QString licenseHash;//LICENSE内容哈希
+    QString kyinfoHash;//.kyinfo内容哈希
+    int version = 0;//行版本，每次修改主行加 1，用于检测并发修改
+};
+
+// CSV 激活数据表解析结果
+struct CSVData {
+    QString serialNumber;//序列号
+    int totalActivations = 0;//总激活次数
+    int remainingActivations = 0;//剩余激活次数
+    QVector<QPair<QString, QString>> activationCodes;//激活码
+};
+
+#endif // SERIALRECORD_H
@@ -0,0 +1,855 @@
+#include "serialtreemodel.h"
+#include <QBrush>
+#include <algorithm>
+
+// internalId 为 0 表示主行；子行的 internalId 为父行的主行 id（从 1 开始，不随行号变化），
+// 删除或插入主行后已有的子行索引仍指向原来的父行
+static const quintptr TopLevelId = 0;
+
+SerialTreeModel::SerialTreeModel(QObject *parent)
+    : QAbstractItemModel(parent)
+    , maxLoadedSerials(256)
+    , moreSerials(false)
+    , serialsLoading(false)
+    , matchColumn(-1)
+    , nextId(1)
+{
+}
+
+QModelIndex SerialTreeModel::index(int row, int column, const QModelIndex &parent) const
+{
+    if (row < 0 || column < 0 || column >= ColumnCount) {
+        return QModelIndex();
+    }
+
+    if (!parent.isValid()) {
+        if (row >= serials.size()) return QModelIndex();
+        return createIndex(row, column, TopLevelId);
+    }
+
+    // 子行没有下级
+    if (parent.internalId() != TopLevelId) {
+        return QModelIndex();
+    }
+    if (parent.row() >= activations.size() || row >= activations[parent.row()].size()) {
+        return QModelIndex();
+    }
+    return createIndex(row, column, quintptr(serialIds.at(parent.row())));
+}
+
+QModelIndex SerialTreeModel::parent(const QModelIndex &child) const
+{
+    if (!child.isValid() || child.internalId() == TopLevelId) {
+        return QModelIndex();
+    }
+    const int row = ownerRow(child);
+    return row < 0 ? QModelIndex() : createIndex(row, 0, TopLevelId);
+}
+
+int SerialTreeModel::rowCount(const QModelIndex &parent) const
+{
+    if (!parent.isValid()) {
+        return serials.size();
+    }
+    if (parent.internalId() != TopLevelId || parent.column() != 0) {
+        return 0;
+    }
+    return activations.value(parent.row()).size();
+}
+
+int SerialTreeModel::columnCount(const QModelIndex &parent) const
+{
+    Q_UNUSED(parent);
+    return ColumnCount;
+}
+
+bool SerialTreeModel::hasChildren(const QModelIndex &parent) const
+{
+    // 子行尚未加载时按数据库中的条数显示展开箭头
+    if (parent.isValid() && parent.internalId() == TopLevelId && parent.column() == 0
+        && childStates.at(parent.row()) != ChildrenLoaded) {
+        return serials.at(parent.row()).activationCount > 0;
+    }
+    return rowCount(parent) > 0;
+}
+
+bool SerialTreeModel::canFetchMore(const QModelIndex &parent) const
+{
+    if (!parent.isValid()) {
+        return moreSerials && !serialsLoading;
+    }
+    if (parent.internalId() != TopLevelId || parent.column() != 0) {
+        return false;
+    }
+    return childStates.at(parent.row()) == ChildrenNotLoaded
+        && serials.at(parent.row()).activationCount > 0;
+}
+
+void SerialTreeModel::fetchMore(const QModelIndex &parent)
+{
+    if (!canFetchMore(parent)) {
+        return;
+    }
+    if (!parent.isValid()) {
+        serialsLoading = true;
+        emit serialsRequested(serialCursor);
+        return;
+    }
+    childStates[parent.row()] = ChildrenLoading;
+    emit activationsRequested(serials.at(parent.row()).serialNumber);
+}
+
+QVariant SerialTreeModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid()) {
+        return QVariant();
+    }
+
+    if (role == Qt::BackgroundRole) {
+        if (highlighted.isValid() && index == highlighted) {
+            return QBrush(Qt::yellow);
+        }
+        if (index.column() == matchColumn && matchIds.contains(recordId(index))) {
+            return QBrush(QColor(255, 250, 205));
+        }
+        return QVariant();
+    }
+
+    if (index.internalId() == TopLevelId) {
+        const SerialRecord &record = serials.at(index.row());
+        if (role == Qt::DisplayRole || role == Qt::EditRole) {
+            switch (index.column()) {
+            case SerialNumberColumn: return record.serialNumber;
+            case TotalActivationsColumn: return QString::number(record.totalActivations);
+            case RemainingActivationsColumn: return QString::number(record.remainingActivations);
+            case PlatformColumn: return record.platform;
+            case VerificationCodeColumn: return record.verificationCode;
+            case LicenseColumn: return record.licenseSize > 0 ? "有" : "无";
+            case KyinfoColumn: return record.kyinfoSize > 0 ? "有" : "无";
+            case BindWechatColumn: return record.bindWechat;
+            case BindPersonColumn: return record.bindPerson;
+            default: return QString();
+            }
+        }
+
+        // 文件大小：下载前据此判断是否需要访问数据库
+        qint64 size = -1;
+        if (index.column() == LicenseColumn) size = record.licenseSize;
+        else if (index.column() == KyinfoColumn) size = record.kyinfoSize;
+        if (size < 0) {
+            return QVariant();
+        }
+        if (role == Qt::UserRole) {
+            return size;
+        }
+        if (role == Qt::ToolTipRole && size > 0) {
+            return QString("%1 字节").arg(size);
+        }
+        return QVariant();
+    }
+
+    if (role != Qt::DisplayRole && role != Qt::EditRole) {
+        return QVariant();
+    }
+
+    const ActivationRecord &record = activations.at(ownerRow(index)).at(index.row());
+    switch (index.column()) {
+    case ActivationCodeColumn: return record.activationCode;
+    case ProjectNumberColumn: return record.projectNumber;
+    case ChassisNumberColumn: return record.chassisNumber;
+    default: return QString();
+    }
+}
+
+bool SerialTreeModel::setData(const QModelIndex &index, const QVariant &value, int role)
+{
+    if (!index.isValid() || role != Qt::EditRole) {
+        return false;
+    }
+
+    const QString text = value.toString();
+
+    if (index.internalId() == TopLevelId) {
+        SerialRecord &record = serials[index.row()];
+        switch (index.column()) {
+        case SerialNumberColumn:
+            serialRows.remove(record.serialNumber);
+            serialNumberIndex.remove(serialIds.at(index.row()), record.serialNumber);
+            record.serialNumber = text;
+            serialRows.insert(text, index.row());
+            serialNumberIndex.insert(serialIds.at(index.row()), text);
+            break;
+        case TotalActivationsColumn: record.totalActivations = text.toInt(); break;
+        case RemainingActivationsColumn: record.remainingActivations = text.toInt(); break;
+        case PlatformColumn: record.platform = text; break;
+        case VerificationCodeColumn: record.verificationCode = text; break;
+        case BindWechatColumn: record.bindWechat = text; break;
+        case BindPersonColumn: record.bindPerson = text; break;
+        default: return false;
+        }
+    } else {
+        if (index.column() < ActivationCodeColumn) {
+            return false;
+        }
+        const int serialRow = ownerRow(index);
+        ActivationRecord &record = activations[serialRow][index.row()];
+        const quint32 id = activationIds.at(serialRow).at(index.row());
+        unindexActivation(id, record);
+        switch (index.column()) {
+        case ActivationCodeColumn: record.activationCode = text; break;
+        case ProjectNumberColumn: record.projectNumber = text; break;
+        case ChassisNumberColumn: record.chassisNumber = text; break;
+        }
+        indexActivation(id, serialIds.at(serialRow), record);
+    }
+
+    emit dataChanged(index, index, {Qt::DisplayRole, Qt::EditRole});
+    return true;
+}
+
+QVariant SerialTreeModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (orientation != Qt::Horizontal || role != Qt::DisplayRole) {
+        return QVariant();
+    }
+
+    static const char *const headers[ColumnCount] = {
+        "序列号", "总激活次数", "剩余次数", "硬件平台", "验证码", "LICENSE", ".kyinfo",
+        "绑定微信", "绑定人", "激活码", "项目号", "机箱序列号"
+    };
+    if (section < 0 || section >= ColumnCount) {
+        return QVariant();
+    }
+    return QString::fromUtf8(headers[section]);
+}
+
+Qt::ItemFlags SerialTreeModel::flags(const QModelIndex &index) const
+{
+    if (!index.isValid()) {
+        return Qt::NoItemFlags;
+    }
+    return Qt::ItemIsEnabled | Qt::ItemIsSelectable;
+}
+
+void SerialTreeModel::setSerials(const QVector<SerialRecord> &records)
+{
+    beginResetModel();
+    serials = records;
+    activations.clear();
+    activations.resize(serials.size());
+    highlighted = QPersistentModelIndex();
+    matchColumn = -1;
+    matchIds.clear();
+    serialCursor.clear();
+    moreSerials = false;
+    serialsLoading = false;
+
+    serialIds.resize(serials.size());
+    childStates.resize(serials.size());
+    loadedSerials.clear();
+    serialNumberIndex.clear();
+    for (int i = 0; i < serials.size(); ++i) {
+        serialIds[i] = nextId++;
+        serialNumberIndex.insert(serialIds.at(i), serials.at(i).serialNumber);
+        childStates[i] = serials.at(i).activationCount > 0 ? ChildrenNotLoaded : ChildrenLoaded;
+    }
+    clearActivationIndex();
+    activationIds.resize(serials.size());
+
+    reindexFrom(0);
+    endResetModel();
+}
+
+void SerialTreeModel::setActivations(const QVector<QVector<ActivationRecord>> &records)
+{
+    beginResetModel();
+    activations = records;
+    activations.resize(serials.size());
+
+    // 给出的即为各主行的全部子行
+    loadedSerials.clear();
+    for (int i = 0; i < serials.size(); ++i) {
+        childStates[i] = ChildrenLoaded;
+        serials[i].activationCount = activations.at(i).size();
+    }
+
+    clearActivationIndex();
+    if (matchColumn >= ActivationCodeColumn) {
+        matchColumn = -1;
+        matchIds.clear();
+    }
+    activationIds.resize(serials.size());
+    for (int i = 0; i < activations.size(); ++i) {
+        const QVector<ActivationRecord> &children = activations.at(i);
+        QVector<quint32> &ids = activationIds[i];
+        ids.resize(children.size());
+        for (int j = 0; j < children.size(); ++j) {
+            ids[j] = nextId++;
+            indexActivation(ids.at(j), serialIds.at(i), children.at(j));
+        }
+    }
+    endResetModel();
+}
+
+void SerialTreeModel::clear()
+{
+    setSerials(QVector<SerialRecord>());
+}
+
+void SerialTreeModel::setFirstSerialPage(const QVector<SerialRecord> &page, bool hasMore)
+{
+    setSerials(page);
+    if (!page.isEmpty()) {
+        serialCursor = page.last().serialNumber;
+    }
+    moreSerials = hasMore;
+}
+
+void SerialTreeModel::appendSerialPage(const QVector<SerialRecord> &page, bool hasMore)
+{
+    serialsLoading = false;
+    moreSerials = hasMore;
+    if (page.isEmpty()) {
+        return;
+    }
+    serialCursor = page.last().serialNumber;
+
+    // 新增或同步来的序列号可能已提前出现在列表中，这些只原位更新
+    QVector<SerialRecord> fresh;
+    fresh.reserve(page.size());
+    for (const SerialRecord &record : page) {
+        if (findSerial(record.serialNumber) >= 0) {
+            upsertSerial(record);
+        } else {
+            fresh.append(record);
+        }
+    }
+    if (fresh.isEmpty()) {
+        return;
+    }
+
+    // 整页一次插入
+    const int first = serials.size();
+    beginInsertRows(QModelIndex(), first, first + fresh.size() - 1);
+    for (const SerialRecord &record : fresh) {
+        insertSerialRecord(record);
+    }
+    endInsertRows();
+}
+
+void SerialTreeModel::cancelSerialFetch()
+{
+    serialsLoading = false;
+}
+
+bool SerialTreeModel::hasMoreSerials() const
+{
+    return moreSerials;
+}
+
+int SerialTreeModel::appendSerial(const SerialRecord &record)
+{
+    const int row = serials.size();
+    beginInsertRows(QModelIndex(), row, row);
+    insertSerialRecord(record);
+    endInsertRows();
+    return row;
+}
+
+void SerialTreeModel::insertSerialRecord(const SerialRecord &record)
+{
+    const int row = serials.size();
+    serials.append(record);
+    activations.append(QVector<ActivationRecord>());
+    serialRows.insert(record.serialNumber, row);
+
+    const quint32 id = nextId++;
+    serialIds.append(id);
+    childStates.append(record.activationCount > 0 ? ChildrenNotLoaded : ChildrenLoaded);
+    activationIds.append(QVector<quint32>());
+    serialIdRows.insert(id, row);
+    serialNumberIndex.insert(id, record.serialNumber);
+}
+
+int SerialTreeModel::upsertSerial(const SerialRecord &record)
+{
+    int row = findSerial(record.serialNumber);
+    if (row < 0) {
+        return appendSerial(record);
+    }
+
+    // 原位更新，子行、展开状态和选中项不受影响
+    serials[row] = record;
+    if (childStates.at(row) == ChildrenNotLoaded && record.activationCount == 0) {
+        childStates[row] = ChildrenLoaded;
+    }
+    emit dataChanged(index(row, 0), index(row, BindPersonColumn), {Qt::DisplayRole, Qt::EditRole});
+    return row;
+}
+
+void SerialTreeModel::removeSerial(int row)
+{
+    if (row < 0 || row >= serials.size()) {
+        return;
+    }
+
+    beginRemoveRows(QModelIndex(), row, row);
+    const quint32 id = serialIds.at(row);
+    serialNumberIndex.remove(id, serials.at(row).serialNumber);
+    for (int i = 0; i < activations.at(row).size(); ++i) {
+        unindexActivation(activationIds.at(row).at(i), activations.at(row).at(i));
+    }
+    serialIdRows.remove(id);
+    serialIds.remove(row);
+    activationIds.remove(row);
+    childStates.remove(row);
+    loadedSerials.removeOne(id);
+
+    serialRows.remove(serials.at(row).serialNumber);
+    serials.remove(row);
+    activations.remove(row);
+    reindexFrom(row);
+    endRemoveRows();
+}
+
+int SerialTreeModel::findSerial(const QString &serialNumber) const
+{
+    return serialRows.value(serialNumber, -1);
+}
+
+const SerialRecord &SerialTreeModel::serial(int row) const
+{
+    return serials.at(row);
+}
+
+void SerialTreeModel::setRemainingActivations(int row, int remaining)
+{
+    serials[row].remainingActivations = remaining;
+    QModelIndex changed = index(row, RemainingActivationsColumn);
+    emit dataChanged(changed, changed, {Qt::DisplayRole, Qt::EditRole});
+}
+
+void SerialTreeModel::appendActivation(int serialRow, const ActivationRecord &record)
+{
+    appendActivations(serialRow, QVector<ActivationRecord>() << record);
+}
+
+void SerialTreeModel::appendActivations(int serialRow, const QVector<ActivationRecord> &records)
+{
+    if (records.isEmpty()) {
+        return;
+    }
+
+    // 子行未加载时只记条数，展开时会从数据库取到完整列表
+    serials[serialRow].activationCount += records.size();
+    if (childStates.at(serialRow) != ChildrenLoaded) {
+        return;
+    }
+
+    QVector<ActivationRecord> &children = activations[serialRow];
+    QVector<quint32> &ids = activationIds[serialRow];
+    const int first = children.size();
+    beginInsertRows(index(serialRow, 0), first, first + records.size() - 1);
+    children += records;
+    for (const ActivationRecord &record : records) {
+        ids.append(nextId++);
+        indexActivation(ids.last(), serialIds.at(serialRow), record);
+    }
+    endInsertRows();
+}
+
+void SerialTreeModel::replaceActivations(int serialRow, const QVector<ActivationRecord> &records)
+{
+    // 子行未加载时只更新条数，展开时再从数据库读取，不占用已加载子行的名额
+    if (childStates.at(serialRow) != ChildrenLoaded) {
+        serials[serialRow].activationCount = records.size();
+        if (records.isEmpty() && childStates.at(serialRow) == ChildrenNotLoaded) {
+            childStates[serialRow] = ChildrenLoaded;
+        }
+        emit dataChanged(index(serialRow, 0), index(serialRow, 0));
+        return;
+    }
+
+    assignActivations(serialRow, records);
+    if (!records.isEmpty()) {
+        touchActivations(serialRow);
+        evictActivations(serialRow);
+    }
+}
+
+void SerialTreeModel::assignActivations(int serialRow, const QVector<ActivationRecord> &records)
+{
+    QVector<ActivationRecord> &children = activations[serialRow];
+    QVector<quint32> &ids = activationIds[serialRow];
+    const QModelIndex parent = index(serialRow, 0);
+
+    // 给出的是完整列表，之后视为已加载
+    childStates[serialRow] = ChildrenLoaded;
+
+    // 公共部分原位更新，多出的行删除，不足的行追加
+    const int common = qMin(children.size(), records.size());
+    for (int i = 0; i < common; ++i) {
+        unindexActivation(ids.at(i), children.at(i));
+        children[i] = records.at(i);
+        indexActivation(ids.at(i), serialIds.at(serialRow), children.at(i));
+    }
+    if (common > 0) {
+        emit dataChanged(index(0, ActivationCodeColumn, parent), index(common - 1, ChassisNumberColumn, parent),
+                         {Qt::DisplayRole, Qt::EditRole});
+    }
+
+    if (children.size() > common) {
+        beginRemoveRows(parent, common, children.size() - 1);
+        for (int i = common; i < children.size(); ++i) {
+            unindexActivation(ids.at(i), children.at(i));
+        }
+        children.resize(common);
+        ids.resize(common);
+        endRemoveRows();
+    } else if (records.size() > common) {
+        appendActivations(serialRow, records.mid(common));
+    }
+    serials[serialRow].activationCount = records.size();
+}
+
+void SerialTreeModel::removeActivation(int serialRow, int row)
+{
+    QVector<ActivationRecord> &children = activations[serialRow];
+    if (row < 0 || row >= children.size()) {
+        return;
+    }
+
+    beginRemoveRows(index(serialRow, 0), row, row);
+    unindexActivation(activationIds.at(serialRow).at(row), children.at(row));
+    children.remove(row);
+    activationIds[serialRow].remove(row);
+    serials[serialRow].activationCount = children.size();
+    endRemoveRows();
+}
+
+void SerialTreeModel::setLoadedActivations(int serialRow, const QVector<ActivationRecord> &records)
+{
+    assignActivations(serialRow, records);
+    touchActivations(serialRow);
+    evictActivations(serialRow);
+}
+
+void SerialTreeModel::evictActivations(int keepRow)
+{
+    // 超过上限时释放最久未展开的主行
+    while (loadedSerials.size() > maxLoadedSerials) {
+        const int row = serialIdRows.value(loadedSerials.takeFirst(), -1);
+        if (row >= 0 && row != keepRow) {
+            releaseActivations(row);
+        }
+    }
+}
+
+void SerialTreeModel::cancelActivationFetch(int serialRow)
+{
+    if (childStates.at(serialRow) == ChildrenLoading) {
+        childStates[serialRow] = ChildrenNotLoaded;
+    }
+}
+
+bool SerialTreeModel::activationsLoaded(int serialRow) const
+{
+    return childStates.at(serialRow) == ChildrenLoaded;
+}
+
+bool SerialTreeModel::hasUnloadedActivations() const
+{
+    for (int i = 0; i < childStates.size(); ++i) {
+        if (childStates.at(i) != ChildrenLoaded && serials.at(i).activationCount > 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void SerialTreeModel::touchActivations(int serialRow)
+{
+    if (childStates.at(serialRow) != ChildrenLoaded) {
+        return;
+    }
+    const quint32 id = serialIds.at(serialRow);
+    loadedSerials.removeOne(id);
+    loadedSerials.append(id);
+}
+
+void SerialTreeModel::setMaxLoadedSerials(int count)
+{
+    maxLoadedSerials = qMax(1, count);
+}
+
+void SerialTreeModel::releaseActivations(int serialRow)
+{
+    QVector<ActivationRecord> &children = activations[serialRow];
+    if (children.isEmpty()) {
+        return;
+    }
+
+    const QModelIndex parent = index(serialRow, 0);
+    beginRemoveRows(parent, 0, children.size() - 1);
+    QVector<quint32> &ids = activationIds[serialRow];
+    for (int i = 0; i < children.size(); ++i) {
+        unindexActivation(ids.at(i), children.at(i));
+    }
+    serials[serialRow].activationCount = children.size();
+    children.clear();
+    ids.clear();
+    childStates[serialRow] = ChildrenNotLoaded;
+    endRemoveRows();
+
+    emit activationsReleased(parent);
+}
+
+int SerialTreeModel::findActivation(int serialRow, const QString &activationCode) const
+{
+    const QVector<ActivationRecord> &children = activations.at(serialRow);
+    for (int i = 0; i < children.size(); ++i) {
+        if (children.at(i).activationCode == activationCode) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+const ActivationRecord &SerialTreeModel::activation(int serialRow, int row) const
+{
+    return activations.at(serialRow).at(row);
+}
+
+bool SerialTreeModel::isSerialIndex(const QModelIndex &index) const
+{
+    return index.isValid() && index.internalId() == TopLevelId;
+}
+
+int SerialTreeModel::serialRowOf(const QModelIndex &index) const
+{
+    if (!index.isValid()) {
+        return -1;
+    }
+    return index.internalId() == TopLevelId ? index.row() : ownerRow(index);
+}
+
+int SerialTreeModel::ownerRow(const QModelIndex &child) const
+{
+    return serialIdRows.value(quint32(child.internalId()), -1);
+}
+
+QModelIndexList SerialTreeModel::search(int column, const QString &text) const
+{
+    QModelIndexList result;
+    if (text.isEmpty()) {
+        return result;
+    }
+
+    QVector<quint32> ids;
+    if (column == SerialNumberColumn) {
+        QVector<int> rows;
+        if (serialNumberIndex.candidates(text, ids)) {
+            rows.reserve(ids.size());
+            for (quint32 id : ids) {
+                rows.append(serialIdRows.value(id));
+            }
+            std::sort(rows.begin(), rows.end());
+        } else {
+            // 查询串太短，逐行比较
+            rows.resize(serials.size());
+            for (int i = 0; i < rows.size(); ++i) rows[i] = i;
+        }
+        for (int row : rows) {
+            if (serials.at(row).serialNumber.contains(text, Qt::CaseInsensitive)) {
+                result.append(index(row, column));
+            }
+        }
+        return result;
+    }
+
+    const TrigramIndex *fieldIndex = activationIndex(column);
+    if (!fieldIndex) {
+        return result;
+    }
+
+    // 候选 id 按所属主行归并，只检查这些主行下的子行
+    const bool filtered = fieldIndex->candidates(text, ids);
+    QVector<int> serialRowList;
+    if (filtered) {
+        for (quint32 id : ids) {
+            serialRowList.append(serialIdRows.value(activationOwners.value(id)));
+        }
+        std::sort(serialRowList.begin(), serialRowList.end());
+        serialRowList.erase(std::unique(serialRowList.begin(), serialRowList.end()), serialRowList.end());
+    } else {
+        serialRowList.resize(activations.size());
+        for (int i = 0; i < serialRowList.size(); ++i) serialRowList[i] = i;
+    }
+
+    for (int serialRow : serialRowList) {
+        const QVector<ActivationRecord> &children = activations.at(serialRow);
+        const QVector<quint32> &childIds = activationIds.at(serialRow);
+        QModelIndex parent;
+        for (int i = 0; i < children.size(); ++i) {
+            if (filtered && !std::binary_search(ids.constBegin(), ids.constEnd(), childIds.at(i))) {
+                continue;
+            }
+            if (!activationText(children.at(i), column).contains(text, Qt::CaseInsensitive)) {
+                continue;
+            }
+            if (!parent.isValid()) {
+                parent = index(serialRow, 0);
+            }
+            result.append(index(i, column, parent));
+        }
+    }
+    return result;
+}
+
+void SerialTreeModel::setHighlightedIndex(const QModelIndex &index)
+{
+    QModelIndex previous = highlighted;
+    highlighted = index;
+    if (previous.isValid()) {
+        emit dataChanged(previous, previous, {Qt::BackgroundRole});
+    }
+    if (index.isValid()) {
+        emit dataChanged(index, index, {Qt::BackgroundRole});
+    }
+}
+
+void SerialTreeModel::setSearchMatches(int column, const QModelIndexList &matches)
+{
+    QSet<quint32> ids;
+    ids.reserve(matches.size());
+    for (const QModelIndex &match : matches) {
+        if (match.isValid() && match.column() == column) {
+            ids.insert(recordId(match));
+        }
+    }
+
+    // 只通知新旧命中项所在的范围
+    const int previousColumn = matchColumn;
+    const QSet<quint32> previous = matchIds;
+    matchColumn = column;
+    matchIds = ids;
+    if (previousColumn >= 0) {
+        emitMatchesChanged(previousColumn, previous);
+    }
+    emitMatchesChanged(column, ids);
+}
+
+void SerialTreeModel::clearSearchMatches()
+{
+    if (matchColumn < 0) {
+        return;
+    }
+    const int previousColumn = matchColumn;
+    const QSet<quint32> previous = matchIds;
+    matchColumn = -1;
+    matchIds.clear();
+    emitMatchesChanged(previousColumn, previous);
+}
+
+quint32 SerialTreeModel::recordId(const QModelIndex &index) const
+{
+    if (index.internalId() == TopLevelId) {
+        return serialIds.at(index.row());
+    }
+    return activationIds.at(ownerRow(index)).at(index.row());
+}
+
+void SerialTreeModel::emitMatchesChanged(int column, const QSet<quint32> &ids)
+{
+    if (ids.isEmpty()) {
+        return;
+    }
+
+    if (column == SerialNumberColumn) {
+        int first = serials.size();
+        int last = -1;
+        for (quint32 id : ids) {
+            const int row = serialIdRows.value(id, -1);
+            if (row < 0) continue;
+            first = qMin(first, row);
+            last = qMax(last, row);
+        }
+        if (last >= 0) {
+            emit dataChanged(index(first, column), index(last, column), {Qt::BackgroundRole});
+        }
+        return;
+    }
+
+    // 子行按主行分组，每个主行通知一次
+    QSet<int> parents;
+    for (quint32 id : ids) {
+        auto owner = activationOwners.constFind(id);
+        if (owner != activationOwners.constEnd()) {
+            parents.insert(serialIdRows.value(owner.value(), -1));
+        }
+    }
+    for (int serialRow : parents) {
+        if (serialRow < 0 || activations.at(serialRow).isEmpty()) continue;
+        const QModelIndex parent = index(serialRow, 0);
+        emit dataChanged(index(0, column, parent), index(activations.at(serialRow).size() - 1, column, parent),
+                         {Qt::BackgroundRole});
+    }
+}
+
+void SerialTreeModel::reindexFrom(int row)
+{
+    if (row == 0) {
+        serialRows.clear();
+        serialRows.reserve(serials.size());
+        serialIdRows.clear();
+        serialIdRows.reserve(serials.size());
+    }
+    for (int i = row; i < serials.size(); ++i) {
+        serialRows.insert(serials.at(i).serialNumber, i);
+        serialIdRows.insert(serialIds.at(i), i);
+    }
+}
+
+void SerialTreeModel::clearActivationIndex()
+{
+    activationIds.clear();
+    activationOwners.clear();
+    activationCodeIndex.clear();
+    projectNumberIndex.clear();
+    chassisNumberIndex.clear();
+}
+
+void SerialTreeModel::indexActivation(quint32 id, quint32 ownerId, const ActivationRecord &record)
+{
+    activationOwners.insert(id, ownerId);
+    activationCodeIndex.insert(id, record.activationCode);
+    projectNumberIndex.insert(id, record.projectNumber);
+    chassisNumberIndex.insert(id, record.chassisNumber);
+}
+
+void SerialTreeModel::unindexActivation(quint32 id, const ActivationRecord &record)
+{
+    activationOwners.remove(id);
+    activationCodeIndex.remove(id, record.activationCode);
+    projectNumberIndex.remove(id, record.projectNumber);
+    chassisNumberIndex.remove(id, record.chassisNumber);
+}
+
+const TrigramIndex *SerialTreeModel::activationIndex(int column) const
+{
+    switch (column) {
+    case ActivationCodeColumn: return &activationCodeIndex;
+    case ProjectNumberColumn: return &projectNumberIndex;
+    case ChassisNumberColumn: return &chassisNumberIndex;
+    default: return nullptr;
+    }
+}
+
+const QString &SerialTreeModel::activationText(const ActivationRecord &record, int column)
+{
+    switch (column) {
+    case ProjectNumberColumn: return record.projectNumber;
+    case ChassisNumberColumn: return record.chassisNumber;
+    default: return record.activationCode;
+    }
+}
@@ -0,0 +1,151 @@
+#ifndef SERIALTREEMODEL_H
+#define SERIALTREEMODEL_H
+
+#include <QAbstractItemModel>
+#include <QHash>
+#include <QSet>
+#include <QPersistentModelIndex>
+#include "serialrecord.h"
+#include "trigramindex.h"
+
+// 序列号/激活码树形模型
+// 主行和子行数据分别存放在连续数组中，显示文本在 data() 中按需生成；
+// 子行在主行首次展开时通过 fetchMore 请求加载，最近展开的若干个主行的子行常驻内存
+class SerialTreeModel : public QAbstractItemModel
+{
+    Q_OBJECT
+
+public:
+    enum Column {
+        SerialNumberColumn = 0,
+        TotalActivationsColumn,
+        RemainingActivationsColumn,
+        PlatformColumn,
+        VerificationCodeColumn,
+        LicenseColumn,
+        KyinfoColumn,
+        BindWechatColumn,
+        BindPersonColumn,
+        ActivationCodeColumn,
+        ProjectNumberColumn,
+        ChassisNumberColumn,
+        ColumnCount
+    };
+
+    explicit SerialTreeModel(QObject *parent = nullptr);
+
+    QModelIndex index(int row, int column, const QModelIndex &parent = QModelIndex()) const override;
+    QModelIndex parent(const QModelIndex &child) const override;
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    bool hasChildren(const QModelIndex &parent = QModelIndex()) const override;
+    bool canFetchMore(const QModelIndex &parent) const override;
+    void fetchMore(const QModelIndex &parent) override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    bool setData(const QModelIndex &index, const QVariant &value, int role = Qt::EditRole) override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+    Qt::ItemFlags flags(const QModelIndex &index) const override;
+
+    // 整体加载
+    void setSerials(const QVector<SerialRecord> &serials);
+    void setActivations(const QVector<QVector<ActivationRecord>> &activations);
+    void clear();
+
+    // 主行分页加载：滚动到底部时 fetchMore 发出 serialsRequested(上一页最后的序列号)，
+    // 调用方取到下一页后交回 appendSerialPage
+    void setFirstSerialPage(const QVector<SerialRecord> &page, bool hasMore);
+    void appendSerialPage(const QVector<SerialRecord> &page, bool hasMore);
+    void cancelSerialFetch();
+    bool hasMoreSerials() const;
+
+    // 主行
+    int appendSerial(const SerialRecord &record);
+    int upsertSerial(const SerialRecord &record);
+    void removeSerial(int row);
+    int findSerial(const QString &serialNumber) const;
+    const SerialRecord &serial(int row) const;
+    void setRemainingActivations(int row, int remaining);
+
+    // 子行
+    void appendActivation(int serialRow, const ActivationRecord &record);
+    void appendActivations(int serialRow, const QVector<ActivationRecord> &records);
+    // 给出完整列表：子行未加载时只更新条数，已加载时原位替换
+    void replaceActivations(int serialRow, const QVector<ActivationRecord> &records);
+    void removeActivation(int serialRow, int row);
+    int findActivation(int serialRow, const QString &activationCode) const;
+    const ActivationRecord &activation(int serialRow, int row) const;
+
+    // 子行按需加载：fetchMore 发出 activationsRequested，调用方查询后交回 setLoadedActivations；
+    // 超过上限时释放最久未展开的主行的子行
+    void setLoadedActivations(int serialRow, const QVector<ActivationRecord> &records);
+    void cancelActivationFetch(int serialRow);
+    bool activationsLoaded(int serialRow) const;
+    bool hasUnloadedActivations() const;
+    void touchActivations(int serialRow);
+    void setMaxLoadedSerials(int count);
+
+    // 索引转换
+    bool isSerialIndex(const QModelIndex &index) const;
+    int serialRowOf(const QModelIndex &index) const;
+
+    // 子串搜索（不区分大小写），按显示顺序返回匹配的单元格
+    QModelIndexList search(int column, const QString &text) const;
+
+    // 搜索高亮：当前项为黄色，其余命中项为浅黄色
+    // 命中集合按记录 id 保存，data() 中查表得到背景色，不修改任何数据
+    void setHighlightedIndex(const QModelIndex &index);
+    void setSearchMatches(int column, const QModelIndexList &matches);
+    void clearSearchMatches();
+
+signals:
+    void serialsRequested(const QString &afterSerialNumber);
+    void activationsRequested(const QString &serialNumber);
+    void activationsReleased(const QModelIndex &parent);
+
+private:
+    enum ChildState : quint8 {
+        ChildrenNotLoaded,
+        ChildrenLoading,
+        ChildrenLoaded
+    };
+
+    QVector<SerialRecord> serials;
+    QVector<QVector<ActivationRecord>> activations;  // 与 serials 按行对应
+    QHash<QString, int> serialRows;                  // 序列号 -> 主行
+    QVector<quint8> childStates;                     // 与 serials 按行对应
+    QList<quint32> loadedSerials;                    // 按需加载了子行的主行 id，最近展开的在末尾
+    int maxLoadedSerials;
+    QString serialCursor;                            // 已加载的最后一页的最后一个序列号
+    bool moreSerials;
+    bool serialsLoading;
+    QPersistentModelIndex highlighted;
+    int matchColumn;
+    QSet<quint32> matchIds;
+
+    // 搜索索引：记录 id 不随行号变化，查询结果再换算成当前行
+    quint32 nextId;
+    QVector<quint32> serialIds;                      // 与 serials 按行对应
+    QVector<QVector<quint32>> activationIds;         // 与 activations 按行对应
+    QHash<quint32, int> serialIdRows;                // 主行 id -> 主行
+    QHash<quint32, quint32> activationOwners;        // 子行 id -> 主行 id
+    TrigramIndex serialNumberIndex;
+    TrigramIndex activationCodeIndex;
+    TrigramIndex projectNumberIndex;
+    TrigramIndex chassisNumberIndex;
+
+    void reindexFrom(int row);
+    int ownerRow(const QModelIndex &child) const;  // 子行所属的主行
+    void insertSerialRecord(const SerialRecord &record);
+    void assignActivations(int serialRow, const QVector<ActivationRecord> &records);
+    void evictActivations(int keepRow);
+    void releaseActivations(int serialRow);
+    void clearActivationIndex();
+    void indexActivation(quint32 id, quint32 ownerId, const ActivationRecord &record);
+    void unindexActivation(quint32 id, const ActivationRecord &record);
+    const TrigramIndex *activationIndex(int column) const;
+    quint32 recordId(const QModelIndex &index) const;
+    void emitMatchesChanged(int column, const QSet<quint32> &ids);
+    static const QString &activationText(const ActivationRecord &record, int column);
+};
+
+#endif // SERIALTREEMODEL_H
@@ -0,0 +1,97 @@
+#include "statementcache.h"
+#include "querymonitor.h"
+#include <QElapsedTimer>
+#include <QDebug>
+#include <algorithm>
+
+StatementCache::StatementCache(const QSqlDatabase &db)
+    : db(db)
+{
+}
+
+StatementCache::~StatementCache()
+{
+    clear();
+}
+
+QSqlQuery &StatementCache::prepare(const QString &sql)
+{
+    Entry *entry = entries.value(sql);
+    if (!entry) {
+        entry = new Entry{QSqlQuery(db), false, Stats()};
+        entry->query.setForwardOnly(true);
+        entry->stats.sql = sql;
+        entries.insert(sql, entry);
+        byQuery.insert(&entry->query, entry);
+    }
+
+    if (entry->prepared) {
+        entry->query.finish();
+    } else {
+        // 预编译失败（如连接断开）时下次使用再试
+        entry->prepared = entry->query.prepare(sql);
+        ++entry->stats.prepares;
+    }
+    return entry->query;
+}
+
+bool StatementCache::exec(QSqlQuery &query)
+{
+    Entry *entry = byQuery.value(&query);
+    if (!entry) {
+        return QueryMonitor::exec(query);
+    }
+    if (!entry->prepared) {
+        return false;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    const bool ok = QueryMonitor::exec(query);
+    const qint64 elapsed = timer.nsecsElapsed();
+
+    ++entry->stats.executions;
+    entry->stats.totalNs += elapsed;
+    entry->stats.maxNs = qMax(entry->stats.maxNs, elapsed);
+    if (!ok) {
+        // 执行失败后重新预编译，避免复用已失效的语句
+        entry->prepared = false;
+    }
+    return ok;
+}
+
+void StatementCache::clear()
+{
+    qDeleteAll(entries);
+    entries.clear();
+    byQuery.clear();
+}
+
+QVector<StatementCache::Stats> StatementCache::stats() const
+{
+    QVector<Stats> result;
+    result.reserve(entries.size());
+    for (const Entry *entry : entries) {
+        result.append(entry->stats);
+    }
+    // 总耗时最多的在前
+    std::sort(result.begin(), result.end(), [](const Stats &a, const Stats &b) {
+        return a.totalNs > b.totalNs;
+    });
+    return result;
+}
+
+void StatementCache::logStats() const
+{
+    for (const Stats &stats : this->stats()) {
+        if (stats.executions == 0) {
+            continue;
+        }
+        qDebug().noquote() << QString("[SQL] %1 次，预编译 %2 次，平均 %3 ms，最长 %4 ms: %5")
+                              .arg(stats.executions)
+                              .arg(stats.prepares)
+                              .arg(stats.totalNs / stats.executions / 1e6, 0, 'f', 2)
+                              .arg(stats.maxNs / 1e6, 0, 'f', 2)
+                              .arg(stats.sql);
+    }
+}
@@ -0,0 +1,51 @@
+#ifndef STATEMENTCACHE_H
+#define STATEMENTCACHE_H
+
+#include <QHash>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QString>
+#include <QVector>
+
+// 预编译语句缓存
+// 同一连接上相同的 SQL 只 prepare 一次（MySQL 上即服务器端预编译语句），之后复用；
+// 同时统计每条语句的执行次数和耗时。连接重建后须 clear()。
+// 缓存不淘汰，只用于形状固定的语句；参数个数可变的 IN 列表须补齐到几种固定长度
+class StatementCache
+{
+public:
+    struct Stats {
+        QString sql;
+        int prepares = 0;
+        qint64 executions = 0;
+        qint64 totalNs = 0;
+        qint64 maxNs = 0;
+    };
+
+    explicit StatementCache(const QSqlDatabase &db);
+    ~StatementCache();
+
+    // 取得已预编译的语句，上次的结果集先被释放；之后用 bindValue(序号, 值) 绑定参数
+    QSqlQuery &prepare(const QString &sql);
+    // 执行并计时；prepare 失败时返回 false，错误在 query.lastError() 中
+    bool exec(QSqlQuery &query);
+
+    void clear();
+    QVector<Stats> stats() const;
+    void logStats() const;
+
+private:
+    Q_DISABLE_COPY(StatementCache)
+
+    struct Entry {
+        QSqlQuery query;
+        bool prepared;
+        Stats stats;
+    };
+
+    QSqlDatabase db;
+    QHash<QString, Entry *> entries;
+    QHash<const QSqlQuery *, Entry *> byQuery;
+};
+
+#endif // STATEMENTCACHE_H
@@ -0,0 +1,103 @@
+#include "trigramindex.h"
+#include <algorithm>
+
+QVector<quint64> TrigramIndex::grams(const QString &text)
+{
+    QVector<quint64> result;
+    if (text.size() < 3) {
+        return result;
+    }
+
+    result.reserve(text.size() - 2);
+    quint64 a = text.at(0).toCaseFolded().unicode();
+    quint64 b = text.at(1).toCaseFolded().unicode();
+    for (int i = 2; i < text.size(); ++i) {
+        const quint64 c = text.at(i).toCaseFolded().unicode();
+        result.append((a << 32) | (b << 16) | c);
+        a = b;
+        b = c;
+    }
+
+    // 同一片段在一条记录中只记一次
+    std::sort(result.begin(), result.end());
+    result.erase(std::unique(result.begin(), result.end()), result.end());
+    return result;
+}
+
+void TrigramIndex::insert(quint32 id, const QString &text)
+{
+    for (quint64 gram : grams(text)) {
+        QVector<quint32> &ids = postings[gram];
+        // id 递增分配，通常直接追加到末尾
+        if (ids.isEmpty() || ids.last() < id) {
+            ids.append(id);
+            continue;
+        }
+        auto it = std::lower_bound(ids.begin(), ids.end(), id);
+        if (it == ids.end() || *it != id) {
+            ids.insert(it, id);
+        }
+    }
+}
+
+void TrigramIndex::remove(quint32 id, const QString &text)
+{
+    for (quint64 gram : grams(text)) {
+        auto posting = postings.find(gram);
+        if (posting == postings.end()) {
+            continue;
+        }
+        QVector<quint32> &ids = posting.value();
+        auto it = std::lower_bound(ids.begin(), ids.end(), id);
+        if (it != ids.end() && *it == id) {
+            ids.erase(it);
+        }
+        if (ids.isEmpty()) {
+            postings.erase(posting);
+        }
+    }
+}
+
+void TrigramIndex::clear()
+{
+    postings.clear();
+}
+
+bool TrigramIndex::candidates(const QString &needle, QVector<quint32> &ids) const
+{
+    ids.clear();
+    const QVector<quint64> keys = grams(needle);
+    if (keys.isEmpty()) {
+        return false;
+    }
+
+    // 从最短的列表开始求交集
+    QVector<const QVector<quint32> *> lists;
+    lists.reserve(keys.size());
+    for (quint64 gram : keys) {
+        auto posting = postings.constFind(gram);
+        if (posting == postings.constEnd()) {
+            return true;
+        }
+        lists.append(&posting.value());
+    }
+    std::sort(lists.begin(), lists.end(), [](const QVector<quint32> *a, const QVector<quint32> *b) {
+        return a->size() < b->size();
+    });
+
+    ids = *lists.first();
+    for (int i = 1; i < lists.size() && !ids.isEmpty(); ++i) {
+        const QVector<quint32> &other = *lists.at(i);
+        QVector<quint32> merged;
+        merged.reserve(ids.size());
+        std::set_intersection(ids.constBegin(), ids.constEnd(), other.constBegin(), other.constEnd(),
+                              std::back_inserter(merged));
+        ids.swap(merged);
+    }
+    return true;
+}
+
+int TrigramIndex::size() const
+{
+    return postings.size();
+}
@@ -0,0 +1,29 @@
+#ifndef TRIGRAMINDEX_H
+#define TRIGRAMINDEX_H
+
+#include <QHash>
+#include <QString>
+#include <QVector>
+
+// 三字符倒排索引，用于子串搜索
+// 记录以 id 标识，每个三字符片段（不区分大小写）对应一个升序的 id 列表；
+// 查询时取各片段列表的交集得到候选 id，调用方再逐条确认
+class TrigramIndex
+{
+public:
+    void insert(quint32 id, const QString &text);
+    void remove(quint32 id, const QString &text);
+    void clear();
+
+    // 查询串不足三个字符时无法过滤，返回 false，调用方应逐条比较
+    bool candidates(const QString &needle, QVector<quint32> &ids) const;
+
+    int size() const;
+
+private:
+    QHash<quint64, QVector<quint32>> postings;
+
+    static QVector<quint64> grams(const QString &text);
+};
+
+#endif // TRIGRAMINDEX_H